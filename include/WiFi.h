@@ -28,7 +28,36 @@
 
 #include "wl_definitions.h"
 #include "wl_types.h"
+#include "wifi_drv.h"
 #include "WiFiClient.h"
+#include "WiFiTask.h"
+
+// How old the cached link info may get before a read fetches it again
+#ifndef WIFI_LINK_REFRESH_MS
+#define WIFI_LINK_REFRESH_MS 1000
+#endif
+
+// Parts of the link info, for change notifications
+#define WIFI_LINK_STATUS    0x01
+#define WIFI_LINK_ADDRESS   0x02
+#define WIFI_LINK_NETWORK   0x04
+#define WIFI_LINK_RSSI      0x08
+#define WIFI_LINK_ALL       0x0F
+
+// Scans are checked quickly at first, backing off to the slower rate, and given up on after the timeout
+#ifndef WIFI_SCAN_POLL_MIN_MS
+#define WIFI_SCAN_POLL_MIN_MS 50
+#endif
+
+#ifndef WIFI_SCAN_POLL_MAX_MS
+#define WIFI_SCAN_POLL_MAX_MS 500
+#endif
+
+#ifndef WIFI_SCAN_TIMEOUT_MS
+#define WIFI_SCAN_TIMEOUT_MS 20000
+#endif
+
+typedef void (*WiFi_linkCallback_t)(const WiFiDrvLinkInfo_t *info, uint8 changed, void *arg);
 
 void WiFi_init();
 
@@ -235,6 +264,38 @@ int32 WiFi_RSSI_index(uint8 networkItem);
  */
 uint8 WiFi_status();
 
+/*
+ * WiFi_status without waiting for it.  The status ends up in op->result.  op must stay valid until
+ * it completes: callback (may be NULL) runs on the I/O task, then notify (may be NULL) gets a task
+ * notification (ulTaskNotifyTake).  See WiFiTask_async.
+ *
+ * return: 1 if queued, 0 if the I/O task's queue was full
+ */
+int WiFi_statusAsync(WiFiTaskOp_t *op, TaskHandle_t notify, WiFiTaskCallback_t callback, void *context);
+
+/*
+ * Link info cache.  Status, addresses, SSID, BSSID, RSSI and encryption type are fetched together
+ * in one batch and served from the cache until they are WIFI_LINK_REFRESH_MS old.  Each part is
+ * updated from its own answer; a refresh with parts missing is tried again on the next read.
+ * Connecting, disconnecting and reconfiguring drop the cache.  info gets a consistent copy.
+ */
+void WiFi_linkInfo(WiFiDrvLinkInfo_t *info);
+
+// Change the refresh period.  0 keeps the cache until it is invalidated.
+void WiFi_setLinkRefresh(uint32 ms);
+
+void WiFi_invalidateLink(void);
+
+/*
+ * Refresh the cache if it is due, e.g. from a housekeeping task so readers never have to wait
+ *
+ * return: WIFI_LINK_* bits of what changed
+ */
+uint8 WiFi_pollLink(void);
+
+// callback is run from whichever task refreshed the cache when anything in mask changes
+void WiFi_onLinkChange(WiFi_linkCallback_t callback, uint8 mask, void *arg);
+
 /*
  * Resolve the given hostname to an IP address.
  * param aHostname: Name to be resolved
@@ -24,6 +24,27 @@
 
 #include "project.h"
 
+#include "FreeRTOS.h"
+#include "WiFiTask.h"
+
+#include <stddef.h>
+
+// How long a connect may take before it is given up on
+#define WIFI_CONNECT_TIMEOUT_MS 10000
+
+// Sends a socket may have in flight before WiFiClient_write waits for DATA_SENT.  1 waits after every send.
+#ifndef WIFI_CLIENT_WRITE_WINDOW
+#define WIFI_CLIENT_WRITE_WINDOW 1
+#endif
+
+typedef enum {
+    WIFI_CONNECT_ESTABLISHED,
+    WIFI_CONNECT_FAILED,
+    WIFI_CONNECT_TIMEOUT
+} WiFiClient_connectResult_t;
+
+typedef void (*WiFiClient_connectCallback_t)(uint8 _sock, WiFiClient_connectResult_t result, void *arg);
+
 int WiFiClient_connect(uint32 ip, uint16 port);
 
 int WiFiClient_connectHostname(uint8 *host, uint16 port);
@@ -32,19 +53,79 @@ int WiFiClient_connectSSL(uint32 ip, uint16 port);
 
 int WiFiClient_connectSSLHostname(uint8 *host, uint16 port);
 
+/*
+ * Non-blocking connects.  These return the socket as soon as the co-processor has accepted
+ * the connect (NO_SOCKET_AVAIL if it did not).  The outcome is reported through callback from
+ * WiFiClient_pollConnects, so several connects can be in progress at once.
+ *
+ * param protMode: TCP_MODE or TLS_MODE
+ */
+int WiFiClient_connectAsync(uint32 ip, uint16 port, uint8 protMode, WiFiClient_connectCallback_t callback, void *arg);
+
+int WiFiClient_connectSSLHostnameAsync(uint8 *host, uint16 port, WiFiClient_connectCallback_t callback, void *arg);
+
+/*
+ * Check all pending connects in one batch, waiting up to timeout for at least one to finish,
+ * and run the callbacks of those that did.
+ *
+ * return: number of connects still pending
+ */
+int WiFiClient_pollConnects(TickType_t timeout);
+
 int WiFiClient_writeChar(uint8 _sock, uint8 ch);
 
 int WiFiClient_write(uint8 _sock, uint8 *buf, size_t size);
 
+/*
+ * Streaming writes: allow up to window sends in flight on this socket before WiFiClient_write
+ * checks DATA_SENT.  0 restores WIFI_CLIENT_WRITE_WINDOW, as does WiFiClient_stop.  Use WiFiClient_flush as
+ * the barrier.
+ */
+void WiFiClient_setWriteWindow(uint8 _sock, uint8 window);
+
 int WiFiClient_available(uint8 _sock);
 
+// A write or available run on the I/O task.  op.result is what the blocking call would have returned.
+typedef struct _WiFiClientRequest {
+    WiFiTaskOp_t op;
+    uint8 sock;
+    uint8 *buf;
+    size_t size;
+} WiFiClientRequest_t;
+
+/*
+ * WiFiClient_write and WiFiClient_available without waiting for them.  The request, and buf, must
+ * stay valid until it completes: callback (may be NULL) runs on the I/O task with &request->op, then
+ * notify (may be NULL) gets a task notification (ulTaskNotifyTake).  context is left in op.context.
+ * See WiFiTask_async.
+ *
+ * return: 1 if queued, 0 if the I/O task's queue was full
+ */
+int WiFiClient_writeAsync(WiFiClientRequest_t *request, uint8 _sock, uint8 *buf, size_t size, TaskHandle_t notify,
+                          WiFiTaskCallback_t callback, void *context);
+int WiFiClient_availableAsync(WiFiClientRequest_t *request, uint8 _sock, TaskHandle_t notify,
+                              WiFiTaskCallback_t callback, void *context);
+
 int WiFiClient_readChar(uint8 _sock);
 
 int WiFiClient_read(uint8 _sock, uint8 *buf, size_t size);
 
+// Like WiFiClient_read, but reads of WIFI_SOCKET_DIRECT_READ_MIN or more go straight into buf
+int WiFiClient_readInto(uint8 _sock, uint8 *buf, size_t size);
+
 int WiFiClient_peek(uint8 _sock);
 
-void WiFiClient_flush(uint8 _sock);
+// See WiFiSocketBuffer_readUntil, WiFiSocketBuffer_readLine and WiFiSocketBuffer_readExact
+int WiFiClient_readUntil(uint8 _sock, uint8 delim, uint8 *buf, size_t size, TickType_t timeout);
+int WiFiClient_readLine(uint8 _sock, char *line, size_t size, TickType_t timeout);
+int WiFiClient_readExact(uint8 _sock, uint8 *buf, size_t size, TickType_t timeout);
+
+/*
+ * Wait until everything written has been sent by the co-processor
+ *
+ * return: 1 once it has, or if nothing was in flight.  0 if DATA_SENT timed out, the data may be lost.
+ */
+int WiFiClient_flush(uint8 _sock);
 
 void WiFiClient_stop(uint8 _sock);
 
@@ -0,0 +1,63 @@
+/*
+  WiFiDnsCache.h - Hostname cache for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFiDnsCache_h
+#define WiFiDnsCache_h
+
+#include "project.h"
+
+#ifndef WIFI_DNS_CACHE_SIZE
+#define WIFI_DNS_CACHE_SIZE 8
+#endif
+
+// Longer hostnames are looked up every time
+#ifndef WIFI_DNS_CACHE_NAME_LENGTH
+#define WIFI_DNS_CACHE_NAME_LENGTH 64
+#endif
+
+#ifndef WIFI_DNS_CACHE_TTL_MS
+#define WIFI_DNS_CACHE_TTL_MS 300000
+#endif
+
+// Failed lookups are remembered for less time so a name that comes back is noticed soon
+#ifndef WIFI_DNS_CACHE_NEGATIVE_TTL_MS
+#define WIFI_DNS_CACHE_NEGATIVE_TTL_MS 10000
+#endif
+
+// What the co-processor reports for a name it could not resolve
+#define WIFI_DNS_FAILED 0xFFFFFFFF
+
+/*
+ * Look a hostname up in the cache.  Names are compared ignoring case.
+ *
+ * return: 1 if it is cached with an address, -1 if it is cached as failed, 0 if it isn't cached
+ */
+int WiFiDnsCache_lookup(const uint8 *host, uint32 *ip);
+
+// Remember a result.  WIFI_DNS_FAILED is kept for the negative TTL.  The least recently used entry makes room.
+void WiFiDnsCache_store(const uint8 *host, uint32 ip);
+
+void WiFiDnsCache_forget(const uint8 *host);
+
+void WiFiDnsCache_flush(void);
+
+// 0 leaves that TTL as it is
+void WiFiDnsCache_setTTL(uint32 ttlMs, uint32 negativeTtlMs);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+  WiFiResolver.h - Background hostname lookups for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFiResolver_h
+#define WiFiResolver_h
+
+#include "project.h"
+#include "WiFiTask.h"
+
+typedef enum {
+    WIFI_RESOLVE_QUEUED,
+    WIFI_RESOLVE_DONE,
+    WIFI_RESOLVE_FAILED
+} WiFiResolverState_t;
+
+typedef struct _WiFiResolverRequest WiFiResolverRequest_t;
+
+typedef void (*WiFiResolverCallback_t)(WiFiResolverRequest_t *request, void *arg);
+
+/*
+ * One lookup.  The caller owns the memory and the hostname, both must stay valid until the
+ * lookup completes.  ip and state are filled in.
+ */
+struct _WiFiResolverRequest {
+    const uint8 *host;
+    uint32 ip;
+    volatile WiFiResolverState_t state;
+    WiFiResolverCallback_t callback;
+    void *arg;
+    WiFiResolverRequest_t *next;
+};
+
+/*
+ * Queue a lookup.  Names in the DNS cache complete at once.  The rest are worked through in
+ * order on the I/O task if it is running, otherwise by WiFiResolver_poll.  Results go into
+ * the DNS cache.  callback (may be NULL) runs on whichever task did the lookup.  Never blocks,
+ * so it is safe from the I/O task; if the I/O task's queue is full the lookup waits for the
+ * next WiFiResolver_start or WiFiResolver_poll.
+ */
+void WiFiResolver_start(WiFiResolverRequest_t *request, const uint8 *host, WiFiResolverCallback_t callback, void *arg);
+
+/*
+ * Work through queued lookups from the calling task.  Only needed while the I/O task runs if
+ * a lookup was started when its queue was full.
+ *
+ * return: lookups completed
+ */
+int WiFiResolver_poll(void);
+
+// Lookups still waiting
+int WiFiResolver_pending(void);
+
+#endif
@@ -0,0 +1,97 @@
+/*
+  WiFiScan.h - Scan results for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFiScan_h
+#define WiFiScan_h
+
+#include "project.h"
+#include "wl_definitions.h"
+#include "wifi_drv.h"
+
+#include "FreeRTOS.h"
+
+typedef enum {
+    WIFI_SCAN_IDLE,
+    WIFI_SCAN_RUNNING,
+    WIFI_SCAN_COMPLETE,
+    WIFI_SCAN_TIMEOUT,
+    WIFI_SCAN_FAILED
+} WiFiScanState_t;
+
+/*
+ * Told how a scan ended.  On WIFI_SCAN_TIMEOUT networks is the table from the last scan that
+ * completed, if there was one, so the caller can go with the best it knows about.
+ */
+typedef void (*WiFiScanCallback_t)(WiFiScanState_t state, const WiFiDrvNetwork_t *networks, uint8 count, void *arg);
+
+/*
+ * Scan and fill in up to max networks with everything known about them, see WiFiDrv_getNetworks.
+ *
+ * return: number of networks filled in, WL_FAILURE if the scan could not be started
+ */
+int WiFiScan_scan(WiFiDrvNetwork_t *networks, uint8 max);
+
+/*
+ * Start a scan without waiting for it.  WiFiScan_poll checks on it, quickly at first and backing
+ * off, and fills the scan table as soon as the co-processor has results.  callback may be NULL.
+ *
+ * return: WL_SUCCESS, or WL_FAILURE if the scan could not be started
+ */
+int WiFiScan_start(TickType_t timeout, WiFiScanCallback_t callback, void *arg);
+
+// Cheap to call often, only goes to the co-processor when the next check is due
+WiFiScanState_t WiFiScan_poll(void);
+
+/*
+ * Scan, waiting no longer than timeout.  If the scan doesn't finish in time the last completed
+ * scan's networks are copied instead.
+ *
+ * return: number of networks copied
+ */
+int WiFiScan_scanWithin(WiFiDrvNetwork_t *networks, uint8 max, TickType_t timeout);
+
+// The table filled in by the last completed async scan
+const WiFiDrvNetwork_t *WiFiScan_table(uint8 *count);
+
+// Fetch the table for the networks already found by the last scan
+int WiFiScan_results(WiFiDrvNetwork_t *networks, uint8 count);
+
+// Strongest first
+void WiFiScan_sortByRssi(WiFiDrvNetwork_t *networks, uint8 count);
+
+// Alphabetical by SSID, strongest first for the same SSID
+void WiFiScan_sortBySsid(WiFiDrvNetwork_t *networks, uint8 count);
+
+/*
+ * Filters drop the networks that don't match and close up the gaps, keeping the order.
+ *
+ * return: networks left
+ */
+uint8 WiFiScan_filterRssi(WiFiDrvNetwork_t *networks, uint8 count, int32 minRssi);
+
+uint8 WiFiScan_filterSsid(WiFiDrvNetwork_t *networks, uint8 count, const uint8 *ssid);
+
+/*
+ * The strongest network with the given SSID, e.g. the access point to roam to
+ *
+ * return: its index, or -1 if there is none
+ */
+int WiFiScan_strongest(const WiFiDrvNetwork_t *networks, uint8 count, const uint8 *ssid);
+
+#endif
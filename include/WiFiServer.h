@@ -0,0 +1,75 @@
+/*
+  WiFiServer.h - TCP servers for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFiServer_h
+#define WiFiServer_h
+
+#include "project.h"
+#include "WiFiSocket.h"
+
+#include "FreeRTOS.h"
+
+#include <stddef.h>
+
+// Clients a server can hold for WiFiServer_accept before new ones are left waiting on the co-processor
+#ifndef WIFI_SERVER_ACCEPT_QUEUE
+#define WIFI_SERVER_ACCEPT_QUEUE 4
+#endif
+
+/*
+ * Listen for TCP connections on port.
+ *
+ * return: the server socket, or NO_SOCKET_AVAIL
+ */
+int WiFiServer_begin(uint16 port);
+
+// Stop listening.  Clients already accepted stay open until they are stopped.
+void WiFiServer_stop(uint8 server);
+
+int WiFiServer_status(uint8 server);
+
+/*
+ * Check for new clients and refresh the state of all tracked ones in one batch.  Clients
+ * that have closed are forgotten.
+ *
+ * return: number of clients waiting to be accepted
+ */
+int WiFiServer_poll(uint8 server);
+
+/*
+ * Hand out the next new client, waiting up to timeout for one.  0 doesn't wait.  The
+ * co-processor only reports a client once it has sent something.
+ *
+ * return: the client socket, or NO_SOCKET_AVAIL
+ */
+int WiFiServer_accept(uint8 server, TickType_t timeout);
+
+// Clients accepted or waiting to be, as of the last poll
+WiFiSocketSet_t WiFiServer_clients(uint8 server);
+
+/*
+ * Write to every connected client
+ *
+ * return: total bytes written
+ */
+int WiFiServer_write(uint8 server, uint8 *buf, size_t size);
+
+int WiFiServer_writeChar(uint8 server, uint8 ch);
+
+#endif
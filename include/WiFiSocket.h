@@ -0,0 +1,90 @@
+/*
+  WiFiSocket.h - Socket readiness for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFiSocket_h
+#define WiFiSocket_h
+
+#include "project.h"
+#include "wl_definitions.h"
+
+#include "FreeRTOS.h"
+
+// Socket events
+#define WIFI_SOCKET_READABLE    0x01
+#define WIFI_SOCKET_WRITABLE    0x02
+#define WIFI_SOCKET_CONNECTED   0x04
+#define WIFI_SOCKET_CLOSED      0x08
+
+// One bit per socket, WIFI_MAX_SOCK_NUM of them
+typedef uint16 WiFiSocketSet_t;
+
+#define WIFI_SOCKET_BIT(sock)   ((WiFiSocketSet_t) 1 << (sock))
+#define WIFI_SOCKET_ALL         ((WiFiSocketSet_t) ((1 << WIFI_MAX_SOCK_NUM) - 1))
+
+// The co-processor is polled quickly at first, backing off to the slower rate while nothing happens
+#ifndef WIFI_SOCKET_POLL_MIN_MS
+#define WIFI_SOCKET_POLL_MIN_MS 1
+#endif
+
+#ifndef WIFI_SOCKET_POLL_MAX_MS
+#define WIFI_SOCKET_POLL_MAX_MS 100
+#endif
+
+// How long a refreshed socket state may be served from the table
+#ifndef WIFI_SOCKET_STATE_MAX_AGE_MS
+#define WIFI_SOCKET_STATE_MAX_AGE_MS 10
+#endif
+
+typedef struct _WiFiSocketState {
+    uint8 tcpState;
+    uint16 available;
+    TickType_t updated;
+    uint8 valid;
+} WiFiSocketState_t;
+
+/*
+ * Refresh TCP state and available bytes for every socket in set in one batch.
+ *
+ * return: the sockets that were refreshed
+ */
+WiFiSocketSet_t WiFiSocket_refresh(WiFiSocketSet_t set);
+
+/*
+ * The table entry for a socket, or NULL if it is older than WIFI_SOCKET_STATE_MAX_AGE_MS
+ */
+const WiFiSocketState_t *WiFiSocket_state(uint8 sock);
+
+// Forget the table entry, e.g. after reading data or changing the connection
+void WiFiSocket_invalidate(uint8 sock);
+
+/*
+ * Get the events currently true for a socket.  Served from the table while the entry is fresh,
+ * otherwise state and available bytes are both refreshed, whichever events were asked for.
+ * Nothing is reported for a socket the co-processor hasn't answered about yet.
+ */
+uint8 WiFiSocket_events(uint8 sock, uint8 events);
+
+/*
+ * Wait until any socket in set has any of events, or timeout passes.
+ *
+ * return: the sockets in set that are ready, 0 on timeout
+ */
+WiFiSocketSet_t WiFiSocket_wait(WiFiSocketSet_t set, uint8 events, TickType_t timeout);
+
+#endif
@@ -23,20 +23,115 @@
 
 #include "project.h"
 #include "wl_definitions.h"
+#include "WiFiTask.h"
 
+#include <stddef.h>
+
+// Reads at least this big bypass the staging buffer and land directly in the caller's buffer
+#ifndef WIFI_SOCKET_DIRECT_READ_MIN
+#define WIFI_SOCKET_DIRECT_READ_MIN 256
+#endif
+
+// Receive buffers shared by all sockets.  A socket only holds one while it has data staged.
+#ifndef WIFI_SOCKET_BUFFER_POOL_SIZE
+#define WIFI_SOCKET_BUFFER_POOL_SIZE 4
+#endif
+
+// Once fewer than this many bytes are staged the next chunk is fetched ahead of the reader
+#ifndef WIFI_SOCKET_BUFFER_LOW_WATER
+#define WIFI_SOCKET_BUFFER_LOW_WATER 512
+#endif
+
+// How long a reader waits for a fetch already in flight on another task before reporting the socket empty
+#ifndef WIFI_SOCKET_BUFFER_FETCH_WAIT_MS
+#define WIFI_SOCKET_BUFFER_FETCH_WAIT_MS 500
+#endif
+
+// A ring over one pool buffer.  Only the first size bytes of it are used.
 typedef struct _WiFiSocketBuffer {
     uint8* data;
-    uint8* head;
-    int length;
+    uint16 head;
+    uint16 length;
+    uint16 size;
+    uint16 lowWater;
+    volatile uint8 fetching;
+    volatile uint8 closed;
+    WiFiTaskOp_t prefetchOp;
 } WiFiSocketBuffer_t;
 
+typedef struct _WiFiSocketBufferPoolStats {
+    uint8 inUse;
+    uint8 highWater;
+    uint32 failures;
+} WiFiSocketBufferPoolStats_t;
+
 void WiFiSocketBuffer_init(void);
 void WiFiSocketBuffer_deinit(void);
 
 void WiFiSocketBuffer_close(int socket);
 
+/*
+ * Bytes staged, fetching more if none are.  If a fetch is already in flight (a prefetch on the I/O
+ * task) this waits up to WIFI_SOCKET_BUFFER_FETCH_WAIT_MS for it rather than report 0 while its data
+ * is on the way.  It can't wait on the I/O task itself, or while holding the bus the fetch needs.
+ */
 int WiFiSocketBuffer_available(int socket);
+int WiFiSocketBuffer_buffered(int socket);
+
+// 1 while a fetch for the socket is in flight, i.e. data may be about to land even though none is staged
+int WiFiSocketBuffer_fetching(int socket);
 int WiFiSocketBuffer_peek(int socket);
 int WiFiSocketBuffer_read(int socket, uint8* data, size_t length);
+int WiFiSocketBuffer_readInto(int socket, uint8* data, size_t length);
+
+/*
+ * Read up to and including delim, stopping early if length fills up or nothing more arrives
+ * within timeout.
+ *
+ * return: bytes read, the last of them is delim if it was found
+ */
+int WiFiSocketBuffer_readUntil(int socket, uint8 delim, uint8* data, size_t length, TickType_t timeout);
+
+/*
+ * Read a line ending in \n into line, NUL terminated and without the \r\n.  Whatever was read
+ * is left in line even if the line is incomplete.
+ *
+ * return: line length, or -1 if no end of line arrived within timeout or line filled up
+ */
+int WiFiSocketBuffer_readLine(int socket, char* line, size_t length, TickType_t timeout);
+
+/*
+ * Read exactly length bytes unless timeout passes first
+ *
+ * return: bytes read, length on success
+ */
+int WiFiSocketBuffer_readExact(int socket, uint8* data, size_t length, TickType_t timeout);
+
+/*
+ * Set the ring depth and low-water mark for a socket.  0 picks the defaults.  Only takes
+ * effect while the socket holds no buffer, i.e. before it reads or once it is drained.
+ *
+ * return: 1 if applied
+ */
+int WiFiSocketBuffer_setDepth(int socket, uint16 size, uint16 lowWater);
+
+/*
+ * Top the ring up now if it is below its low-water mark, e.g. from idle time.  Reads queue
+ * this on the I/O task by themselves when it is running.
+ *
+ * return: bytes staged
+ */
+int WiFiSocketBuffer_prefetch(int socket);
+
+/*
+ * Borrow a WIFI_SOCKET_BUFFER_SIZE buffer from the pool for other staging, e.g. UDP datagrams.
+ *
+ * return: the buffer, or NULL if the pool is exhausted
+ */
+uint8 *WiFiSocketBuffer_poolGet(void);
+void WiFiSocketBuffer_poolPut(uint8 *data);
+
+void WiFiSocketBuffer_getPoolStats(WiFiSocketBufferPoolStats_t *stats);
+void WiFiSocketBuffer_resetPoolStats(void);
 
 #endif
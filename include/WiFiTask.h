@@ -0,0 +1,97 @@
+/*
+  WiFiTask.h - Optional network I/O task for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFiTask_h
+#define WiFiTask_h
+
+#include "project.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#ifndef WIFI_TASK_QUEUE_LENGTH
+#define WIFI_TASK_QUEUE_LENGTH 8
+#endif
+
+/*
+ * The notification WiFiTask_call waits on, kept off index 0 so the caller's own notifications are left
+ * alone.  FreeRTOSConfig.h has to set configTASK_NOTIFICATION_ARRAY_ENTRIES above it (FreeRTOS 10.4 on).
+ */
+#ifndef WIFI_TASK_NOTIFY_INDEX
+#define WIFI_TASK_NOTIFY_INDEX 1
+#endif
+
+typedef struct _WiFiTaskOp WiFiTaskOp_t;
+
+typedef int (*WiFiTaskHandler_t)(void *arg);
+
+typedef void (*WiFiTaskCallback_t)(WiFiTaskOp_t *op);
+
+/*
+ * One queued operation.  The caller owns the memory, which must stay valid until it completes.
+ * On completion result is filled in, then callback (if set) is run on the I/O task, then notify
+ * (if set) gets a task notification on notifyIndex.  The notification comes last so the waiting
+ * task can reuse op as soon as it wakes.
+ */
+struct _WiFiTaskOp {
+    WiFiTaskHandler_t handler;
+    void *arg;
+    int result;
+    TaskHandle_t notify;
+    WiFiTaskCallback_t callback;
+    void *context;
+    UBaseType_t notifyIndex;    // 0 is the one xTaskNotifyGive/ulTaskNotifyTake use
+};
+
+/*
+ * Start the I/O task.  It holds the SPI bus for each operation it runs, so an operation's commands
+ * go out without other tasks in between, and gives it up before the next one.  Public calls still
+ * run on the caller's task; only the operations queued here (read-ahead, background lookups) run on it.
+ *
+ * return: 1 on success
+ */
+int WiFiTask_start(UBaseType_t priority, uint16 stackDepth);
+
+int WiFiTask_running(void);
+
+// 1 if called from the I/O task itself, e.g. from an operation's handler or callback
+int WiFiTask_current(void);
+
+// Queue an operation.  Returns 0 if the queue stayed full for timeout.
+int WiFiTask_submit(WiFiTaskOp_t *op, TickType_t timeout);
+
+// Queue an operation ahead of everything already waiting
+int WiFiTask_submitUrgent(WiFiTaskOp_t *op, TickType_t timeout);
+
+/*
+ * Run handler on the I/O task and wait for its result, on notification WIFI_TASK_NOTIFY_INDEX.
+ * Runs it directly if the I/O task is not running or if called from the I/O task itself.
+ */
+int WiFiTask_call(WiFiTaskHandler_t handler, void *arg);
+
+/*
+ * Fill in op and queue it without waiting.  It completes as described for WiFiTaskOp_t, with
+ * notify getting notification 0.  If the I/O task is not running it is run and completed here.
+ *
+ * return: 1 if queued or run, 0 if the queue was full
+ */
+int WiFiTask_async(WiFiTaskOp_t *op, WiFiTaskHandler_t handler, void *arg, TaskHandle_t notify,
+                   WiFiTaskCallback_t callback, void *context);
+
+#endif
@@ -0,0 +1,84 @@
+/*
+  WiFiUDP.h - UDP sockets for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef WiFiUDP_h
+#define WiFiUDP_h
+
+#include "project.h"
+
+#include <stddef.h>
+
+/*
+ * Listen for datagrams on port.  Sending only also needs a socket, port 0 lets the
+ * co-processor pick one.
+ *
+ * return: the socket, or NO_SOCKET_AVAIL
+ */
+int WiFiUDP_begin(uint16 port);
+
+// Like WiFiUDP_begin, also joining the multicast group ip
+int WiFiUDP_beginMulticast(uint32 ip, uint16 port);
+
+void WiFiUDP_stop(uint8 _sock);
+
+/*
+ * Start building a datagram to ip:port.  Writes are collected in a pool buffer and passed on
+ * in as few INSERT_DATABUF_CMD transfers as possible, WiFiUDP_endPacket sends the datagram.
+ *
+ * return: 1 on success
+ */
+int WiFiUDP_beginPacket(uint8 _sock, uint32 ip, uint16 port);
+
+int WiFiUDP_beginPacketHostname(uint8 _sock, uint8 *host, uint16 port);
+
+/*
+ * return: number of bytes taken.  Once part of the datagram could not be passed on, the rest of
+ *         the write and any later ones take nothing and WiFiUDP_endPacket fails.
+ */
+int WiFiUDP_write(uint8 _sock, uint8 *buf, size_t size);
+
+int WiFiUDP_writeChar(uint8 _sock, uint8 ch);
+
+// return: 1 if the datagram was sent
+int WiFiUDP_endPacket(uint8 _sock);
+
+/*
+ * Move on to the next received datagram, dropping whatever is left of the current one.
+ * A datagram that fits is fetched whole in one transfer.
+ *
+ * return: size of the datagram, 0 if none has arrived
+ */
+int WiFiUDP_parsePacket(uint8 _sock);
+
+// Bytes left in the current datagram
+int WiFiUDP_available(uint8 _sock);
+
+// Reads never run past the end of the current datagram
+int WiFiUDP_read(uint8 _sock, uint8 *buf, size_t size);
+
+int WiFiUDP_readChar(uint8 _sock);
+
+int WiFiUDP_peek(uint8 _sock);
+
+// Sender of the current datagram
+uint32 WiFiUDP_remoteIP(uint8 _sock);
+
+uint16 WiFiUDP_remotePort(uint8 _sock);
+
+#endif
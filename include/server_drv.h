@@ -25,6 +25,9 @@
 #include "project.h"
 #include "wifi_spi.h"
 
+// How long ServerDrv_checkDataSent waits for the co-processor to send
+#define DATA_SENT_TIMEOUT_MS 2500
+
 typedef enum eProtMode {
     TCP_MODE, UDP_MODE, TLS_MODE, UDP_MULTICAST_MODE
 } tProtMode;
@@ -45,8 +48,17 @@ int ServerDrv_getServerState(uint8 sock);
 
 int ServerDrv_getClientState(uint8 sock);
 
+/*
+ * Query client state and available bytes of several sockets in one batch.  valid[i] is set
+ * only if both replies for socks[i] were read, otherwise states[i] and avail[i] mean nothing.
+ *
+ * return: number of sockets with valid results
+ */
+int ServerDrv_getSocketStates(uint8 *socks, uint8 count, uint8 *states, uint16 *avail, uint8 *valid);
+
 int ServerDrv_getData(uint8 sock, uint8 *data, uint8 peek);
 
+// *len is the most to read on the way in, and what was read on the way out
 int ServerDrv_getDataBuf(uint8 sock, uint8 *data, uint16 *len);
 
 int ServerDrv_insertDataBuf(uint8 sock, uint8 *_data, uint16 _dataLen);
@@ -55,6 +67,12 @@ int ServerDrv_sendData(uint8 sock, uint8 *data, uint16 len);
 
 int ServerDrv_sendUdpData(uint8 sock);
 
+/*
+ * Bytes waiting on a client socket.  On a server socket, a client with data waiting instead, or
+ * NO_SOCKET_AVAIL if there is none.
+ *
+ * return: as above, or -1 if the reply could not be read
+ */
 int ServerDrv_availData(uint8 sock);
 
 int ServerDrv_checkDataSent(uint8 sock);
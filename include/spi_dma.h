@@ -0,0 +1,47 @@
+/*
+  spi_dma.h - DMA transport for the WiFiNINA SPI driver.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SPI_Dma_h
+#define SPI_Dma_h
+
+#include "project.h"
+#include "spi_drv.h"
+
+/*
+ * Only built with WIFI_SPI_DMA defined.  The schematic needs, alongside SPIM_WIFI:
+ *   DMA_WIFI_TX   - drq from SPIM_WIFI tx_interrupt (Tx FIFO not full), memory -> SPIM_WIFI_TXDATA
+ *   DMA_WIFI_RX   - drq from SPIM_WIFI rx_interrupt (Rx FIFO not empty), SPIM_WIFI_RXDATA -> memory
+ *   isr_WIFI_DMA_RX - on the nrq of DMA_WIFI_RX
+ * SPIM_WIFI Tx and Rx buffer sizes must be 4 (hardware FIFO only) so the DMA sees the FIFOs directly.
+ *
+ *   SpiDrv_setTransport(&SpiDma_transport);
+ *   WiFi_init();
+ */
+
+// Bytes per DMA descriptor.  Received chunks alternate between two buffers of this size, as do sent
+// chunks that don't live in SRAM (the Tx channel can't read flash).
+#ifndef SPI_DMA_CHUNK_SIZE
+#define SPI_DMA_CHUNK_SIZE 64
+#endif
+
+#ifdef WIFI_SPI_DMA
+extern const SpiTransport_t SpiDma_transport;
+#endif
+
+#endif
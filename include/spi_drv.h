@@ -25,14 +25,54 @@
 #include "project.h"
 #include "wifi_spi.h"
 #include "FreeRTOS.h"
+#include "task.h"
 
 #define DUMMY_DATA  0xFF
 
-// Due to RxBuffer size limitations in the SPIM module.  I can probably work out making this 1500 later.
-#define WIFI_SOCKET_BUFFER_SIZE 255
+// Largest payload moved by a single GET_DATABUF_TCP_CMD or SEND_DATA_TCP_CMD.  Transfers are split into
+// SPIM-sized chunks under one slave select, so this is not limited by the SPIM RxBuffer.
+#ifndef WIFI_SOCKET_BUFFER_SIZE
+#define WIFI_SOCKET_BUFFER_SIZE 1500
+#endif
+
+/*
+ * Moves bytes over the bus with the slave already selected.  A NULL tx clocks out zeros, a NULL rx throws away
+ * what comes back.  transfer() must not return until the last byte has been clocked in.  begin() may be NULL.
+ */
+typedef struct _SpiTransport {
+    void (*begin)(void);
+    void (*transfer)(const uint8 *tx, uint8 *rx, uint16 len);
+} SpiTransport_t;
+
+// SPIM software buffers, one byte at a time.  Used unless another transport is selected.
+extern const SpiTransport_t SpiDrv_byteTransport;
+
+// Select the transport before SpiDrv_begin().  NULL selects SpiDrv_byteTransport.
+void SpiDrv_setTransport(const SpiTransport_t *transport);
+
+// How long a command waits for another task to finish its command/response pair
+#ifndef WIFI_SPI_BUS_TIMEOUT_MS
+#define WIFI_SPI_BUS_TIMEOUT_MS 2000
+#endif
 
+/*
+ * Creates the bus lock and resets the co-processor.  Call it once (WiFi_init does) before any task
+ * touches the bus; until then every command fails.
+ */
 void SpiDrv_begin(void);
 
+/*
+ * Bus ownership.  Every SpiDrv_sendCmd/SpiDrv_sendBuffer takes the bus and the matching
+ * SpiDrv_receiveResponse* call gives it back, so each command/response pair is atomic.
+ * Callers may also hold the bus around a sequence of commands; the lock nests.
+ * Returns 0 if the bus could not be had within timeout, or SpiDrv_begin() has not run yet.
+ */
+int SpiDrv_lockBus(TickType_t timeout);
+
+void SpiDrv_unlockBus(void);
+
+int SpiDrv_ownsBus(void);
+
 void SpiDrv_end(void);
 
 void SpiDrv_waitForSlaveSelect(void);
@@ -47,12 +87,94 @@ void SpiDrv_waitForSlaveReady();
 
 void SpiDrv_waitForSlaveReadyTimeout(TickType_t timeout);
 
-void SpiDrv_sendBuffer(uint8 cmd, uint8 numParam, tDataParam *params);
+/*
+ * Scatter-gather send: large parameters are clocked out from their own buffers, not copied into txBuffer.
+ * SpiDrv_sendBuffer and SpiDrv_sendCmd return 0 if the bus could not be had, in which case nothing was sent
+ * and the matching SpiDrv_receiveResponse* call fails.
+ */
+int SpiDrv_sendBuffer(uint8 cmd, uint8 numParam, tDataParam *params);
 
 int SpiDrv_receiveResponseBuffer(uint8 cmd, uint16 maxSize, uint8 *numParamRead, tDataParam *params, uint8 maxNumParams);
 
-void SpiDrv_sendCmd(uint8 cmd, uint8 numParam, tParam *params);
+int SpiDrv_sendCmd(uint8 cmd, uint8 numParam, tParam *params);
 
 int SpiDrv_receiveResponseCmd(uint8 cmd, uint16 maxSize, uint8 *numParamRead, tParam *params, uint8 maxNumParams);
 
+// One command/response pair of a SpiDrv_runCommands batch.  paramsRead and result are filled in.
+typedef struct _SpiDrvCmd {
+    uint8 cmd;
+    uint8 numParam;
+    tParam *params;
+    uint16 maxReplySize;
+    uint8 maxReplyParams;
+    tParam *replyParams;
+    uint8 paramsRead;
+    int result;
+} SpiDrvCmd_t;
+
+/*
+ * Run independent commands back to back while holding the bus, so no other task's commands
+ * come in between.
+ *
+ * return: number of commands that got a valid reply
+ */
+int SpiDrv_runCommands(SpiDrvCmd_t *cmds, uint8 count);
+
+/*
+ * Instrumentation, only built with WIFI_SPI_STATS defined.  Times are in WIFI_SPI_STATS_TIMESTAMP()
+ * units, which are ticks unless a project supplies a finer clock (e.g. a free running timer in us).
+ */
+#ifdef WIFI_SPI_STATS
+
+#ifndef WIFI_SPI_STATS_TIMESTAMP
+#define WIFI_SPI_STATS_TIMESTAMP() ((uint32) xTaskGetTickCount())
+#endif
+
+// Latency bucket 0 is 0, bucket n is [2^(n-1), 2^n) and the last one takes everything longer
+#ifndef WIFI_SPI_STATS_BUCKETS
+#define WIFI_SPI_STATS_BUCKETS 12
+#endif
+
+// Kept for each opcode the drivers send, see SpiDrv_getCmdStats
+typedef struct _SpiDrvCmdStats {
+    uint32 count;
+    uint32 failures;
+    uint32 latency[WIFI_SPI_STATS_BUCKETS];
+} SpiDrvCmdStats_t;
+
+typedef struct _SpiDrvStats {
+    uint32 bytesSent;
+    uint32 bytesReceived;
+    uint32 busyWaitTime;
+    uint32 waitCharSpins;
+
+    // Reply parse failures
+    uint32 errCmd;
+    uint32 badStart;
+    uint32 badCmd;
+    uint32 badLength;
+    uint32 badEnd;
+
+    uint32 dataSentRetries;
+} SpiDrvStats_t;
+
+// Only updated by the bus owner, except where noted
+extern SpiDrvStats_t SpiDrv_stats;
+
+#define SPI_DRV_STATS_ADD(field, n) (SpiDrv_stats.field += (n))
+
+// Copy the counters out while holding the bus so they are consistent.  Never touches the co-processor.
+void SpiDrv_getStats(SpiDrvStats_t *stats);
+
+// Copy out the counters for one opcode.  Returns 0 if it isn't one the drivers send.
+int SpiDrv_getCmdStats(uint8 cmd, SpiDrvCmdStats_t *stats);
+
+void SpiDrv_resetStats(void);
+
+#else
+
+#define SPI_DRV_STATS_ADD(field, n) do {} while (0)
+
+#endif
+
 #endif
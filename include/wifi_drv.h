@@ -25,6 +25,8 @@
 #include "project.h"
 #include "wifi_spi.h"
 
+#include <string.h>
+
 // Key index length
 #define KEY_IDX_LEN     1
 // 5 secs of delay to have the connection established
@@ -175,6 +177,35 @@ int32 WiFiDrv_getCurrentRSSI(void);
  */
 int WiFiDrv_getCurrentEncryptionType(void);
 
+// Everything about the current link, as fetched together by WiFiDrv_getLinkInfo
+typedef struct _WiFiDrvLinkInfo {
+    uint8 status;
+    uint32 localIp;
+    uint32 subnetMask;
+    uint32 gatewayIp;
+    uint8 ssid[WL_SSID_MAX_LENGTH + 1];
+    uint8 bssid[WL_MAC_ADDR_LENGTH];
+    int32 rssi;
+    uint8 encryptionType;
+} WiFiDrvLinkInfo_t;
+
+// Parts of WiFiDrvLinkInfo_t, each fetched by its own command
+#define WIFI_DRV_LINK_STATUS      0x01
+#define WIFI_DRV_LINK_ADDRESS     0x02
+#define WIFI_DRV_LINK_SSID        0x04
+#define WIFI_DRV_LINK_BSSID       0x08
+#define WIFI_DRV_LINK_RSSI        0x10
+#define WIFI_DRV_LINK_ENCRYPTION  0x20
+#define WIFI_DRV_LINK_ALL         0x3F
+
+/*
+ * Get the connection status, all three addresses, SSID, BSSID, RSSI and encryption type
+ * in one batch.  Parts whose query wasn't answered are left with nothing useful in them.
+ *
+ * return: WIFI_DRV_LINK_* bits of the parts that were answered
+ */
+int WiFiDrv_getLinkInfo(WiFiDrvLinkInfo_t *info);
+
 /*
  * Start scan WiFi networks available
  *
@@ -220,12 +251,47 @@ uint8 *WiFiDrv_getBSSIDNetworks(uint8 networkItem, uint8 *bssid);
 
 int WiFiDrv_getChannelNetworks(uint8 networkItem);
 
+// Networks fetched per SpiDrv_runCommands batch by WiFiDrv_getNetworks, four commands each
+#ifndef WIFI_DRV_NETWORKS_PER_BATCH
+#define WIFI_DRV_NETWORKS_PER_BATCH 5
+#endif
+
+// One network from the scanned list, as fetched together by WiFiDrv_getNetworks
+typedef struct _WiFiDrvNetwork {
+    uint8 ssid[WL_SSID_MAX_LENGTH + 1];
+    uint8 bssid[WL_MAC_ADDR_LENGTH];
+    int32 rssi;
+    uint8 channel;
+    uint8 encryptionType;
+} WiFiDrvNetwork_t;
+
+/*
+ * Fill in the first count networks of the scanned list.  The SSIDs come from the last
+ * WiFiDrv_getScanNetworks.  Everything else takes four command/response pairs per network, run
+ * back to back in batches of WIFI_DRV_NETWORKS_PER_BATCH networks while holding the bus.
+ * Networks that could not be fetched in full are left out, so networks[0..return) are all good.
+ *
+ * return: number of networks completely filled in
+ */
+int WiFiDrv_getNetworks(WiFiDrvNetwork_t *networks, uint8 count);
+
+/*
+ * The two halves of WiFiDrv_getHostByName.  Hold the bus across both so another lookup can't
+ * replace the result in between.
+ *
+ * return: 1 if it resolved, 0 if it did not, -1 if there was no reply.  The results only fill in
+ *         aResult when there was a reply.
+ */
+int WiFiDrv_reqHostByName(uint8 *aHostname);
+
+int WiFiDrv_getHostByNameResults(uint32 *aResult);
+
 /*
  * Resolve the given hostname to an IP address.
  * param aHostname: Name to be resolved
  * param aResult: uint32 to store the returned IP address
  * result: 1 if aIPAddrString was successfully converted to an IP address,
- *          else error code
+ *          else error code.  aResult is 0xFFFFFFFF if the co-processor could not resolve it.
  */
 int WiFiDrv_getHostByName(uint8 *aHostname, uint32 *aResult);
 
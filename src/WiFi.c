@@ -22,12 +22,126 @@
 #include "project.h"
 #include "wifi_drv.h"
 #include "WiFi.h"
+#include "WiFiDnsCache.h"
 
 #include "wl_definitions.h"
 #include "wl_types.h"
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include <string.h>
+
+// Until the first refresh succeeds there is nothing to report
+static WiFiDrvLinkInfo_t WiFi_link = {.status = WL_NO_SHIELD};
+static uint8 WiFi_linkValid = 0;
+static uint8 WiFi_linkFilled = 0;
+static TickType_t WiFi_linkUpdated = 0;
+static TickType_t WiFi_linkRefresh = pdMS_TO_TICKS(WIFI_LINK_REFRESH_MS);
+
+static WiFi_linkCallback_t WiFi_linkCallback = NULL;
+static uint8 WiFi_linkMask = 0;
+static void *WiFi_linkArg = NULL;
+
+static uint8 WiFi_refreshLink(void);
+
+static void WiFi_getLink(WiFiDrvLinkInfo_t *link);
+
+
+static uint8 WiFi_refreshLink(void) {
+    WiFiDrvLinkInfo_t info;
+    WiFiDrvLinkInfo_t link;
+    uint8 changed = 0;
+    int answered;
+
+    answered = WiFiDrv_getLinkInfo(&info);
+    if (!answered) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL();
+    link = WiFi_link;
+    taskEXIT_CRITICAL();
+
+    // Take each part from its own answer, anything that wasn't answered keeps what we had
+    if ((answered & WIFI_DRV_LINK_STATUS) && (!WiFi_linkFilled || info.status != link.status)) {
+        link.status = info.status;
+        changed |= WIFI_LINK_STATUS;
+    }
+    if ((answered & WIFI_DRV_LINK_ADDRESS) &&
+        (!WiFi_linkFilled || info.localIp != link.localIp || info.subnetMask != link.subnetMask ||
+         info.gatewayIp != link.gatewayIp)) {
+        link.localIp = info.localIp;
+        link.subnetMask = info.subnetMask;
+        link.gatewayIp = info.gatewayIp;
+        changed |= WIFI_LINK_ADDRESS;
+    }
+    if ((answered & WIFI_DRV_LINK_SSID) && (!WiFi_linkFilled || memcmp(info.ssid, link.ssid, sizeof(info.ssid)))) {
+        memcpy(link.ssid, info.ssid, sizeof(info.ssid));
+        changed |= WIFI_LINK_NETWORK;
+    }
+    if ((answered & WIFI_DRV_LINK_BSSID) && (!WiFi_linkFilled || memcmp(info.bssid, link.bssid, sizeof(info.bssid)))) {
+        memcpy(link.bssid, info.bssid, sizeof(info.bssid));
+        changed |= WIFI_LINK_NETWORK;
+    }
+    if ((answered & WIFI_DRV_LINK_ENCRYPTION) && (!WiFi_linkFilled || info.encryptionType != link.encryptionType)) {
+        link.encryptionType = info.encryptionType;
+        changed |= WIFI_LINK_NETWORK;
+    }
+    if ((answered & WIFI_DRV_LINK_RSSI) && (!WiFi_linkFilled || info.rssi != link.rssi)) {
+        link.rssi = info.rssi;
+        changed |= WIFI_LINK_RSSI;
+    }
+
+    // Readers copy the cache out under the same lock, so they never see half an update
+    taskENTER_CRITICAL();
+    WiFi_link = link;
+    WiFi_linkFilled = 1;
+    // Only a complete answer holds off the next refresh, otherwise the missing parts are asked for again
+    if (answered == WIFI_DRV_LINK_ALL) {
+        WiFi_linkValid = 1;
+        WiFi_linkUpdated = xTaskGetTickCount();
+    }
+    taskEXIT_CRITICAL();
+
+    if (WiFi_linkCallback && (changed & WiFi_linkMask)) {
+        WiFi_linkCallback(&link, changed, WiFi_linkArg);
+    }
+    return changed;
+}
+
+static void WiFi_getLink(WiFiDrvLinkInfo_t *link) {
+    WiFi_pollLink();
+
+    taskENTER_CRITICAL();
+    *link = WiFi_link;
+    taskEXIT_CRITICAL();
+}
+
+void WiFi_linkInfo(WiFiDrvLinkInfo_t *info) {
+    WiFi_getLink(info);
+}
+
+void WiFi_setLinkRefresh(uint32 ms) {
+    WiFi_linkRefresh = pdMS_TO_TICKS(ms);
+}
+
+void WiFi_invalidateLink(void) {
+    WiFi_linkValid = 0;
+}
+
+uint8 WiFi_pollLink(void) {
+    if (WiFi_linkValid && (!WiFi_linkRefresh || xTaskGetTickCount() - WiFi_linkUpdated < WiFi_linkRefresh)) {
+        return 0;
+    }
+    return WiFi_refreshLink();
+}
+
+void WiFi_onLinkChange(WiFi_linkCallback_t callback, uint8 mask, void *arg) {
+    WiFi_linkCallback = NULL;
+    WiFi_linkMask = mask;
+    WiFi_linkArg = arg;
+    WiFi_linkCallback = callback;
+}
 
 void WiFi_setLEDs(uint8 red, uint8 green, uint8 blue) {
     WiFiDrv_pinMode(25, 1);  // OUTPUT
@@ -55,6 +169,7 @@ int WiFi_begin_common(void) {
         status = WiFiDrv_getConnectionStatus();
     } while (((status == WL_IDLE_STATUS) || (status == WL_NO_SSID_AVAIL) || (status == WL_SCAN_COMPLETED)) &&
              (--attempts > 0));
+    WiFi_invalidateLink();
     return status;
 
 }
@@ -90,6 +205,7 @@ uint8 WiFi_beginAP_common(void) {
         vTaskDelay(pdMS_TO_TICKS(WL_DELAY_START_CONNECTION));
         status = WiFiDrv_getConnectionStatus();
     } while (((status == WL_IDLE_STATUS) || (status == WL_SCAN_COMPLETED)) && (--attempts > 0));
+    WiFi_invalidateLink();
     return status;
 }
 
@@ -118,22 +234,26 @@ uint8 WiFi_beginAP_ssid_passphrase_channel(uint8 *ssid, uint8 *passphrase, uint8
 
 void WiFi_config_static(uint32 local_ip) {
     WiFiDrv_config(1, (uint32) local_ip, 0, 0);
+    WiFi_invalidateLink();
 }
 
 void WiFi_config_static_dns(uint32 local_ip, uint32 dns_server) {
     WiFiDrv_config(1, (uint32) local_ip, 0, 0);
     WiFiDrv_setDNS(1, (uint32) dns_server, 0);
+    WiFi_invalidateLink();
 }
 
 void WiFi_config_static_dns_gateway(uint32 local_ip, uint32 dns_server, uint32 gateway) {
     WiFiDrv_config(2, (uint32) local_ip, (uint32) gateway, 0);
     WiFiDrv_setDNS(1, (uint32) dns_server, 0);
+    WiFi_invalidateLink();
 }
 
 void
 WiFi_config_static_dns_gateway_subnet(uint32 local_ip, uint32 dns_server, uint32 gateway, uint32 subnet) {
     WiFiDrv_config(3, (uint32) local_ip, (uint32) gateway, (uint32) subnet);
     WiFiDrv_setDNS(1, (uint32) dns_server, 0);
+    WiFi_invalidateLink();
 }
 
 void WiFi_setDNS(uint32 dns_server1) {
@@ -149,11 +269,14 @@ void WiFi_setHostname(uint8 *name) {
 }
 
 int WiFi_disconnect() {
-    return WiFiDrv_disconnect();
+    int result = WiFiDrv_disconnect();
+    WiFi_invalidateLink();
+    return result;
 }
 
 void WiFi_end(void) {
     WiFiDrv_wifiDriverDeinit();
+    WiFi_invalidateLink();
 }
 
 uint8 *WiFi_macAddress(uint8 *mac) {
@@ -163,55 +286,84 @@ uint8 *WiFi_macAddress(uint8 *mac) {
 }
 
 uint32 WiFi_localIP() {
-    uint32 ret;
-    WiFiDrv_getIpAddress(&ret);
-    return ret;
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    return link.localIp;
 }
 
 uint32 WiFi_subnetMask() {
-    uint32 ret;
-    WiFiDrv_getSubnetMask(&ret);
-    return ret;
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    return link.subnetMask;
 }
 
 uint32 WiFi_gatewayIP() {
-    uint32 ret;
-    WiFiDrv_getGatewayIP(&ret);
-    return ret;
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    return link.gatewayIp;
 }
 
 uint8 *WiFi_SSID() {
-    return WiFiDrv_getCurrentSSID();
+    static uint8 ssid[WL_SSID_MAX_LENGTH + 1];
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    memcpy(ssid, link.ssid, sizeof(ssid));
+    return ssid;
 }
 
 uint8 *WiFi_BSSID(uint8 *bssid) {
-    uint8 *_bssid = WiFiDrv_getCurrentBSSID();
-    memcpy(bssid, _bssid, WL_MAC_ADDR_LENGTH);
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    memcpy(bssid, link.bssid, WL_MAC_ADDR_LENGTH);
     return bssid;
 }
 
 int32 WiFi_RSSI() {
-    return WiFiDrv_getCurrentRSSI();
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    return link.rssi;
 }
 
 uint8 WiFi_encryptionType() {
-    return WiFiDrv_getCurrentEncryptionType();
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    return link.encryptionType;
 }
 
 
 int8 WiFi_scanNetworks() {
-    uint8 attempts = 10;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t delay = pdMS_TO_TICKS(WIFI_SCAN_POLL_MIN_MS);
+    TickType_t maxDelay = pdMS_TO_TICKS(WIFI_SCAN_POLL_MAX_MS);
     uint8 numOfNetworks = 0;
 
     if (WiFiDrv_startScanNetworks() == WL_FAILURE) {
         return WL_FAILURE;
     }
 
-    do {
-        vTaskDelay(pdMS_TO_TICKS(2000));
+    if (delay == 0) {
+        delay = 1;
+    }
+
+    for (;;) {
+        vTaskDelay(delay);
         numOfNetworks = WiFiDrv_getScanNetworks();
-    } while ((numOfNetworks == 0) && (--attempts > 0));
-    return numOfNetworks;
+        if (numOfNetworks || xTaskGetTickCount() - start >= pdMS_TO_TICKS(WIFI_SCAN_TIMEOUT_MS)) {
+            return numOfNetworks;
+        }
+
+        delay *= 2;
+        if (delay > maxDelay) {
+            delay = maxDelay;
+        }
+    }
 }
 
 uint8 *WiFi_SSID_index(uint8 networkItem) {
@@ -235,11 +387,45 @@ uint8 WiFi_channel_index(uint8 networkItem) {
 }
 
 uint8 WiFi_status() {
-    return WiFiDrv_getConnectionStatus();
+    WiFiDrvLinkInfo_t link;
+
+    WiFi_getLink(&link);
+    return link.status;
+}
+
+static int WiFi_statusHandler(void *arg) {
+    (void) arg;
+    return WiFi_status();
+}
+
+int WiFi_statusAsync(WiFiTaskOp_t *op, TaskHandle_t notify, WiFiTaskCallback_t callback, void *context) {
+    return WiFiTask_async(op, WiFi_statusHandler, NULL, notify, callback, context);
 }
 
 int WiFi_hostByName(uint8 *aHostname, uint32 *aResult) {
-    return WiFiDrv_getHostByName(aHostname, aResult);
+    uint32 ip = 0;
+
+    switch (WiFiDnsCache_lookup(aHostname, &ip)) {
+        case 1:
+            *aResult = ip;
+            return 1;
+        case -1:
+            return 0;
+        default:
+            break;
+    }
+
+    if (WiFiDrv_getHostByName(aHostname, &ip)) {
+        WiFiDnsCache_store(aHostname, ip);
+        *aResult = ip;
+        return 1;
+    }
+
+    // Only a lookup the co-processor answered as failed is remembered, not a bus error
+    if (ip == WIFI_DNS_FAILED) {
+        WiFiDnsCache_store(aHostname, ip);
+    }
+    return 0;
 }
 
 unsigned long WiFi_getTime() {
@@ -22,8 +22,10 @@
 #include "wl_definitions.h"
 #include "wl_types.h"
 #include "server_drv.h"
+#include "spi_drv.h"
 #include "wifi_drv.h"
 #include "WiFiSocketBuffer.h"
+#include "WiFiSocket.h"
 
 #include "WiFi.h"
 #include "WiFiClient.h"
@@ -31,8 +33,23 @@
 #include "FreeRTOS.h"
 #include "task.h"
 
+typedef struct _WiFiClientConnect {
+    WiFiClient_connectCallback_t callback;
+    void *arg;
+    TickType_t start;
+} WiFiClientConnect_t;
+
+static WiFiClientConnect_t WiFiClient_connects[WIFI_MAX_SOCK_NUM];
+static WiFiSocketSet_t WiFiClient_pendingConnects = 0;
+
+// Streaming writes: sends not yet confirmed by DATA_SENT_TCP_CMD, and how many are allowed
+static uint8 WiFiClient_inFlight[WIFI_MAX_SOCK_NUM];
+static uint8 WiFiClient_writeWindow[WIFI_MAX_SOCK_NUM];
+
 static int WiFiClient_connectCommon(uint8 _sock);
 
+static int WiFiClient_connectPending(uint8 _sock, WiFiClient_connectCallback_t callback, void *arg);
+
 int WiFiClient_connectHostname(uint8 *host, uint16 port) {
     uint32 remote_addr;
     if (WiFi_hostByName(host, &remote_addr)) {
@@ -52,12 +69,9 @@ int WiFiClient_connect(uint32 ip, uint16 port) {
 }
 
 static int WiFiClient_connectCommon(uint8 _sock) {
-    TickType_t start = xTaskGetTickCount();
-
     // wait 10 second for the connection to connect
-    while (!WiFiClient_connected(_sock) && (xTaskGetTickCount() - start < pdMS_TO_TICKS(10000))) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
+    WiFiSocket_wait(WIFI_SOCKET_BIT(_sock), WIFI_SOCKET_CONNECTED | WIFI_SOCKET_READABLE,
+                    pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS));
 
     if (!WiFiClient_connected(_sock)) {
         return NO_SOCKET_AVAIL;
@@ -65,6 +79,81 @@ static int WiFiClient_connectCommon(uint8 _sock) {
     return _sock;
 }
 
+static int WiFiClient_connectPending(uint8 _sock, WiFiClient_connectCallback_t callback, void *arg) {
+    WiFiClient_connects[_sock].callback = callback;
+    WiFiClient_connects[_sock].arg = arg;
+    WiFiClient_connects[_sock].start = xTaskGetTickCount();
+    WiFiClient_pendingConnects |= WIFI_SOCKET_BIT(_sock);
+    WiFiSocket_invalidate(_sock);
+    return _sock;
+}
+
+int WiFiClient_connectAsync(uint32 ip, uint16 port, uint8 protMode, WiFiClient_connectCallback_t callback, void *arg) {
+    uint8 _sock = ServerDrv_getSocket();
+    if (_sock == NO_SOCKET_AVAIL) {
+        return _sock;
+    }
+
+    if (ServerDrv_startClient(ip, port, _sock, protMode) != 1) {
+        return NO_SOCKET_AVAIL;
+    }
+    return WiFiClient_connectPending(_sock, callback, arg);
+}
+
+int WiFiClient_connectSSLHostnameAsync(uint8 *host, uint16 port, WiFiClient_connectCallback_t callback, void *arg) {
+    uint8 _sock = ServerDrv_getSocket();
+    if (_sock == NO_SOCKET_AVAIL) {
+        return _sock;
+    }
+
+    if (ServerDrv_startClientHostname(host, ustrlen(host), 0, port, _sock, TLS_MODE) != 1) {
+        return NO_SOCKET_AVAIL;
+    }
+    return WiFiClient_connectPending(_sock, callback, arg);
+}
+
+int WiFiClient_pollConnects(TickType_t timeout) {
+    WiFiSocketSet_t done;
+    int pending = 0;
+
+    if (!WiFiClient_pendingConnects) {
+        return 0;
+    }
+
+    done = WiFiSocket_wait(WiFiClient_pendingConnects, WIFI_SOCKET_CONNECTED | WIFI_SOCKET_CLOSED, timeout);
+
+    for (uint8 _sock = 0; _sock < WIFI_MAX_SOCK_NUM; _sock++) {
+        WiFiClientConnect_t *connect = &WiFiClient_connects[_sock];
+        WiFiClient_connectResult_t result;
+
+        if (!(WiFiClient_pendingConnects & WIFI_SOCKET_BIT(_sock))) {
+            continue;
+        }
+
+        if (done & WIFI_SOCKET_BIT(_sock)) {
+            // Served from the table WiFiSocket_wait just refreshed
+            result = (WiFiClient_status(_sock) == CLOSED) ? WIFI_CONNECT_FAILED : WIFI_CONNECT_ESTABLISHED;
+        } else if (xTaskGetTickCount() - connect->start >= pdMS_TO_TICKS(WIFI_CONNECT_TIMEOUT_MS)) {
+            result = WIFI_CONNECT_TIMEOUT;
+        } else {
+            pending++;
+            continue;
+        }
+
+        WiFiClient_pendingConnects &= ~WIFI_SOCKET_BIT(_sock);
+        if (result != WIFI_CONNECT_ESTABLISHED) {
+            // Don't hang around waiting for it to close, this is meant to be non-blocking
+            ServerDrv_stopClient(_sock);
+            WiFiSocket_invalidate(_sock);
+        }
+        if (connect->callback) {
+            connect->callback(_sock, result, connect->arg);
+        }
+    }
+
+    return pending;
+}
+
 int WiFiClient_connectSSL(uint32 ip, uint16 port) {
     uint8 _sock = ServerDrv_getSocket();
     if (_sock == NO_SOCKET_AVAIL) {
@@ -90,16 +179,51 @@ int WiFiClient_writeChar(uint8 _sock, uint8 ch) {
 }
 
 int WiFiClient_write(uint8 _sock, uint8 *buf, size_t size) {
-    if (_sock == NO_SOCKET_AVAIL || size == 0) {
+    int total = 0;
+
+    if (_sock >= WIFI_MAX_SOCK_NUM || size == 0) {
         return 0;
     }
 
-    int written = ServerDrv_sendData(_sock, buf, size);
-    if (!written || !ServerDrv_checkDataSent(_sock)) {
-        return 0;
+    uint8 window = WiFiClient_writeWindow[_sock] ? WiFiClient_writeWindow[_sock] : WIFI_CLIENT_WRITE_WINDOW;
+    int unacked = 0;
+
+    while (size > 0) {
+        uint16 chunk = (size > WIFI_SOCKET_BUFFER_SIZE) ? WIFI_SOCKET_BUFFER_SIZE : size;
+
+        int written = ServerDrv_sendData(_sock, buf, chunk);
+        if (!written) {
+            break;
+        }
+
+        total += written;
+        unacked += written;
+        buf += written;
+        size -= written;
+
+        // DATA_SENT covers everything sent so far, so one check drains the whole window
+        if (++WiFiClient_inFlight[_sock] >= window) {
+            WiFiClient_inFlight[_sock] = 0;
+            if (!ServerDrv_checkDataSent(_sock)) {
+                return total - unacked;
+            }
+            unacked = 0;
+        }
     }
 
-    return written;
+    return total;
+}
+
+void WiFiClient_setWriteWindow(uint8 _sock, uint8 window) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return;
+    }
+
+    // Shrinking the window must not leave more in flight than it allows
+    if (window < WiFiClient_inFlight[_sock]) {
+        WiFiClient_flush(_sock);
+    }
+    WiFiClient_writeWindow[_sock] = window;
 }
 
 int WiFiClient_available(uint8 _sock) {
@@ -107,9 +231,48 @@ int WiFiClient_available(uint8 _sock) {
         return 0;
     }
 
+    // A fetch in flight has taken data the table no longer counts
+    if (!WiFiSocketBuffer_buffered(_sock) && !WiFiSocketBuffer_fetching(_sock)) {
+        const WiFiSocketState_t *state = WiFiSocket_state(_sock);
+        if (state && state->available == 0) {
+            return 0;
+        }
+
+        // About to pull data, so the table's count no longer holds
+        WiFiSocket_invalidate(_sock);
+    }
+
     return WiFiSocketBuffer_available(_sock);
 }
 
+static int WiFiClient_writeHandler(void *arg) {
+    WiFiClientRequest_t *request = arg;
+
+    return WiFiClient_write(request->sock, request->buf, request->size);
+}
+
+static int WiFiClient_availableHandler(void *arg) {
+    WiFiClientRequest_t *request = arg;
+
+    return WiFiClient_available(request->sock);
+}
+
+int WiFiClient_writeAsync(WiFiClientRequest_t *request, uint8 _sock, uint8 *buf, size_t size, TaskHandle_t notify,
+                          WiFiTaskCallback_t callback, void *context) {
+    request->sock = _sock;
+    request->buf = buf;
+    request->size = size;
+    return WiFiTask_async(&request->op, WiFiClient_writeHandler, request, notify, callback, context);
+}
+
+int WiFiClient_availableAsync(WiFiClientRequest_t *request, uint8 _sock, TaskHandle_t notify,
+                              WiFiTaskCallback_t callback, void *context) {
+    request->sock = _sock;
+    request->buf = NULL;
+    request->size = 0;
+    return WiFiTask_async(&request->op, WiFiClient_availableHandler, request, notify, callback, context);
+}
+
 int WiFiClient_readChar(uint8 _sock) {
     if (!WiFiClient_available(_sock)) {
         return -1;
@@ -124,27 +287,66 @@ int WiFiClient_read(uint8 _sock, uint8 *buf, size_t size) {
     return WiFiSocketBuffer_read(_sock, buf, size);
 }
 
+int WiFiClient_readInto(uint8 _sock, uint8 *buf, size_t size) {
+    if (_sock == NO_SOCKET_AVAIL) {
+        return 0;
+    }
+
+    return WiFiSocketBuffer_readInto(_sock, buf, size);
+}
+
 int WiFiClient_peek(uint8 _sock) {
     return WiFiSocketBuffer_peek(_sock);
 }
 
-void WiFiClient_flush(uint8 _sock) {
-    // TODO: a real check to ensure transmission has been completed
+int WiFiClient_readUntil(uint8 _sock, uint8 delim, uint8 *buf, size_t size, TickType_t timeout) {
+    if (_sock == NO_SOCKET_AVAIL) {
+        return 0;
+    }
+
+    return WiFiSocketBuffer_readUntil(_sock, delim, buf, size, timeout);
 }
 
-void WiFiClient_stop(uint8 _sock) {
+int WiFiClient_readLine(uint8 _sock, char *line, size_t size, TickType_t timeout) {
     if (_sock == NO_SOCKET_AVAIL) {
+        return -1;
+    }
+
+    return WiFiSocketBuffer_readLine(_sock, line, size, timeout);
+}
+
+int WiFiClient_readExact(uint8 _sock, uint8 *buf, size_t size, TickType_t timeout) {
+    if (_sock == NO_SOCKET_AVAIL) {
+        return 0;
+    }
+
+    return WiFiSocketBuffer_readExact(_sock, buf, size, timeout);
+}
+
+int WiFiClient_flush(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM || !WiFiClient_inFlight[_sock]) {
+        return 1;
+    }
+
+    WiFiClient_inFlight[_sock] = 0;
+    return ServerDrv_checkDataSent(_sock);
+}
+
+void WiFiClient_stop(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
         return;
     }
 
-    ServerDrv_stopClient(_sock);
+    WiFiClient_flush(_sock);
 
-    int count = 0;
+    // The next connection on this socket starts from the default window
+    WiFiClient_writeWindow[_sock] = 0;
+
+    ServerDrv_stopClient(_sock);
+    WiFiSocket_invalidate(_sock);
 
     // wait maximum 5 secs for the connection to close
-    while (WiFiClient_status(_sock) != CLOSED && ++count < 50) {
-        vTaskDelay(pdMS_TO_TICKS(100));
-    }
+    WiFiSocket_wait(WIFI_SOCKET_BIT(_sock), WIFI_SOCKET_CLOSED, pdMS_TO_TICKS(5000));
 
     WiFiSocketBuffer_close(_sock);
     _sock = NO_SOCKET_AVAIL;
@@ -155,7 +357,8 @@ int WiFiClient_connected(uint8 _sock) {
         return 0;
     }
 
-    if (WiFiClient_available(_sock)) {
+    // The tail of the stream may still be on its way in after the far end closed
+    if (WiFiClient_available(_sock) || WiFiSocketBuffer_fetching(_sock)) {
         return 1;
     }
 
@@ -176,6 +379,11 @@ int WiFiClient_status(uint8 _sock) {
     if (_sock == NO_SOCKET_AVAIL) {
         return CLOSED;
     }
+
+    const WiFiSocketState_t *state = WiFiSocket_state(_sock);
+    if (state) {
+        return state->tcpState;
+    }
     return ServerDrv_getClientState(_sock);
 }
 
@@ -0,0 +1,173 @@
+/*
+  WiFiDnsCache.c - Hostname cache for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "WiFiDnsCache.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <ctype.h>
+#include <string.h>
+
+#define FNV_OFFSET_BASIS 2166136261UL
+#define FNV_PRIME        16777619UL
+
+typedef struct _WiFiDnsCacheEntry {
+    uint32 hash;
+    uint32 ip;
+    TickType_t expires;
+    TickType_t used;
+    uint8 valid;
+    uint8 name[WIFI_DNS_CACHE_NAME_LENGTH + 1];
+} WiFiDnsCacheEntry_t;
+
+static WiFiDnsCacheEntry_t WiFiDnsCache_entries[WIFI_DNS_CACHE_SIZE];
+static TickType_t WiFiDnsCache_ttl = pdMS_TO_TICKS(WIFI_DNS_CACHE_TTL_MS);
+static TickType_t WiFiDnsCache_negativeTtl = pdMS_TO_TICKS(WIFI_DNS_CACHE_NEGATIVE_TTL_MS);
+
+static uint32 WiFiDnsCache_hash(const uint8 *host, size_t *len);
+
+static WiFiDnsCacheEntry_t *WiFiDnsCache_find(const uint8 *host, TickType_t now);
+
+
+// FNV-1a over the lowercased name, as DNS names don't care about case
+static uint32 WiFiDnsCache_hash(const uint8 *host, size_t *len) {
+    uint32 hash = FNV_OFFSET_BASIS;
+    size_t i;
+
+    for (i = 0; host[i]; i++) {
+        hash ^= (uint8) tolower(host[i]);
+        hash *= FNV_PRIME;
+    }
+
+    *len = i;
+    return hash;
+}
+
+// Must be called in a critical section.  Expired entries are dropped on the way.
+static WiFiDnsCacheEntry_t *WiFiDnsCache_find(const uint8 *host, TickType_t now) {
+    size_t len;
+    uint32 hash = WiFiDnsCache_hash(host, &len);
+
+    if (len > WIFI_DNS_CACHE_NAME_LENGTH) {
+        return NULL;
+    }
+
+    for (int i = 0; i < WIFI_DNS_CACHE_SIZE; i++) {
+        WiFiDnsCacheEntry_t *entry = &WiFiDnsCache_entries[i];
+        size_t j;
+
+        if (!entry->valid || entry->hash != hash) {
+            continue;
+        }
+
+        if ((int32) (now - entry->expires) >= 0) {
+            entry->valid = 0;
+            continue;
+        }
+
+        // The hash only narrows it down
+        for (j = 0; j <= len && entry->name[j] == tolower(host[j]); j++) {
+        }
+        if (j > len) {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+int WiFiDnsCache_lookup(const uint8 *host, uint32 *ip) {
+    TickType_t now = xTaskGetTickCount();
+    int result = 0;
+
+    taskENTER_CRITICAL();
+    WiFiDnsCacheEntry_t *entry = WiFiDnsCache_find(host, now);
+    if (entry) {
+        entry->used = now;
+        *ip = entry->ip;
+        result = (entry->ip == WIFI_DNS_FAILED) ? -1 : 1;
+    }
+    taskEXIT_CRITICAL();
+
+    return result;
+}
+
+void WiFiDnsCache_store(const uint8 *host, uint32 ip) {
+    TickType_t now = xTaskGetTickCount();
+    size_t len;
+    uint32 hash = WiFiDnsCache_hash(host, &len);
+
+    if (len > WIFI_DNS_CACHE_NAME_LENGTH) {
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    WiFiDnsCacheEntry_t *entry = WiFiDnsCache_find(host, now);
+    if (!entry) {
+        // A free slot if there is one, otherwise the least recently used
+        entry = &WiFiDnsCache_entries[0];
+        for (int i = 0; i < WIFI_DNS_CACHE_SIZE && entry->valid; i++) {
+            WiFiDnsCacheEntry_t *candidate = &WiFiDnsCache_entries[i];
+            if (!candidate->valid || (TickType_t) (now - candidate->used) > (TickType_t) (now - entry->used)) {
+                entry = candidate;
+            }
+        }
+
+        entry->hash = hash;
+        for (size_t j = 0; j <= len; j++) {
+            entry->name[j] = tolower(host[j]);
+        }
+    }
+
+    entry->ip = ip;
+    entry->used = now;
+    entry->expires = now + ((ip == WIFI_DNS_FAILED) ? WiFiDnsCache_negativeTtl : WiFiDnsCache_ttl);
+    entry->valid = 1;
+    taskEXIT_CRITICAL();
+}
+
+void WiFiDnsCache_forget(const uint8 *host) {
+    TickType_t now = xTaskGetTickCount();
+
+    taskENTER_CRITICAL();
+    WiFiDnsCacheEntry_t *entry = WiFiDnsCache_find(host, now);
+    if (entry) {
+        entry->valid = 0;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void WiFiDnsCache_flush(void) {
+    taskENTER_CRITICAL();
+    for (int i = 0; i < WIFI_DNS_CACHE_SIZE; i++) {
+        WiFiDnsCache_entries[i].valid = 0;
+    }
+    taskEXIT_CRITICAL();
+}
+
+void WiFiDnsCache_setTTL(uint32 ttlMs, uint32 negativeTtlMs) {
+    if (ttlMs) {
+        WiFiDnsCache_ttl = pdMS_TO_TICKS(ttlMs);
+    }
+    if (negativeTtlMs) {
+        WiFiDnsCache_negativeTtl = pdMS_TO_TICKS(negativeTtlMs);
+    }
+}
@@ -0,0 +1,184 @@
+/*
+  WiFiResolver.c - Background hostname lookups for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "spi_drv.h"
+#include "wifi_drv.h"
+#include "WiFiDnsCache.h"
+#include "WiFiTask.h"
+#include "WiFiResolver.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+static WiFiResolverRequest_t *WiFiResolver_head = NULL;
+static WiFiResolverRequest_t *WiFiResolver_tail = NULL;
+static int WiFiResolver_count = 0;
+
+// One operation per lookup on the I/O task, requeued while there are more
+static WiFiTaskOp_t WiFiResolver_op;
+static uint8 WiFiResolver_queued = 0;
+
+static void WiFiResolver_complete(WiFiResolverRequest_t *request, uint32 ip, int resolved);
+
+static void WiFiResolver_lookup(WiFiResolverRequest_t *request);
+
+static WiFiResolverRequest_t *WiFiResolver_next(uint8 fromTask);
+
+static int WiFiResolver_run(void *arg);
+
+
+static void WiFiResolver_complete(WiFiResolverRequest_t *request, uint32 ip, int resolved) {
+    request->ip = ip;
+    request->state = resolved ? WIFI_RESOLVE_DONE : WIFI_RESOLVE_FAILED;
+
+    if (request->callback) {
+        request->callback(request, request->arg);
+    }
+}
+
+static void WiFiResolver_lookup(WiFiResolverRequest_t *request) {
+    uint32 ip = WIFI_DNS_FAILED;
+    int result;
+
+    // Another lookup could be queued behind this one for the same name
+    if (WiFiDnsCache_lookup(request->host, &ip)) {
+        WiFiResolver_complete(request, ip, ip != WIFI_DNS_FAILED);
+        return;
+    }
+
+    if (!SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS))) {
+        WiFiResolver_complete(request, WIFI_DNS_FAILED, 0);
+        return;
+    }
+
+    result = WiFiDrv_reqHostByName((uint8 *) request->host);
+    if (result == 1) {
+        result = WiFiDrv_getHostByNameResults(&ip);
+    }
+    SpiDrv_unlockBus();
+
+    // A bus error in either half isn't the name's fault, so only an answered lookup is cached
+    if (result >= 0) {
+        WiFiDnsCache_store(request->host, ip);
+    }
+    WiFiResolver_complete(request, ip, result == 1);
+}
+
+static WiFiResolverRequest_t *WiFiResolver_next(uint8 fromTask) {
+    WiFiResolverRequest_t *request;
+
+    taskENTER_CRITICAL();
+    request = WiFiResolver_head;
+    if (request) {
+        WiFiResolver_head = request->next;
+        if (!WiFiResolver_head) {
+            WiFiResolver_tail = NULL;
+        }
+        WiFiResolver_count--;
+    } else if (fromTask) {
+        // Cleared together with finding the queue empty so a new lookup always gets picked up
+        WiFiResolver_queued = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    return request;
+}
+
+static int WiFiResolver_run(void *arg) {
+    WiFiResolverRequest_t *request;
+    int count = 0;
+
+    (void) arg;
+
+    while ((request = WiFiResolver_next(1)) != NULL) {
+        WiFiResolver_lookup(request);
+        count++;
+
+        // The I/O task holds the bus for the whole operation, so let others on before the next lookup
+        if (WiFiTask_submit(&WiFiResolver_op, 0)) {
+            break;
+        }
+    }
+    return count;
+}
+
+void WiFiResolver_start(WiFiResolverRequest_t *request, const uint8 *host, WiFiResolverCallback_t callback, void *arg) {
+    uint32 ip;
+    int cached;
+    uint8 submit = 0;
+
+    request->host = host;
+    request->callback = callback;
+    request->arg = arg;
+    request->next = NULL;
+    request->state = WIFI_RESOLVE_QUEUED;
+
+    cached = WiFiDnsCache_lookup(host, &ip);
+    if (cached) {
+        WiFiResolver_complete(request, ip, cached > 0);
+        return;
+    }
+
+    taskENTER_CRITICAL();
+    if (WiFiResolver_tail) {
+        WiFiResolver_tail->next = request;
+    } else {
+        WiFiResolver_head = request;
+    }
+    WiFiResolver_tail = request;
+    WiFiResolver_count++;
+
+    if (WiFiTask_running() && !WiFiResolver_queued) {
+        WiFiResolver_queued = 1;
+        submit = 1;
+    }
+    taskEXIT_CRITICAL();
+
+    if (submit) {
+        WiFiResolver_op.handler = WiFiResolver_run;
+        WiFiResolver_op.arg = NULL;
+        WiFiResolver_op.notify = NULL;
+        WiFiResolver_op.callback = NULL;
+        WiFiResolver_op.context = NULL;
+
+        // Never wait for room, this could be the I/O task itself.  A lookup left behind by a
+        // full queue goes with the next one started, or to WiFiResolver_poll.
+        if (!WiFiTask_submit(&WiFiResolver_op, 0)) {
+            taskENTER_CRITICAL();
+            WiFiResolver_queued = 0;
+            taskEXIT_CRITICAL();
+        }
+    }
+}
+
+int WiFiResolver_poll(void) {
+    WiFiResolverRequest_t *request;
+    int count = 0;
+
+    while ((request = WiFiResolver_next(0)) != NULL) {
+        WiFiResolver_lookup(request);
+        count++;
+    }
+    return count;
+}
+
+int WiFiResolver_pending(void) {
+    return WiFiResolver_count;
+}
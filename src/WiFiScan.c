@@ -0,0 +1,222 @@
+/*
+  WiFiScan.c - Scan results for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "wl_definitions.h"
+#include "wifi_drv.h"
+#include "WiFi.h"
+#include "WiFiScan.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+static WiFiDrvNetwork_t WiFiScan_networks[WL_NETWORKS_LIST_MAXNUM];
+static uint8 WiFiScan_count = 0;
+
+static WiFiScanState_t WiFiScan_state = WIFI_SCAN_IDLE;
+static TickType_t WiFiScan_started;
+static TickType_t WiFiScan_timeout;
+static TickType_t WiFiScan_nextPoll;
+static TickType_t WiFiScan_delay;
+static WiFiScanCallback_t WiFiScan_callback = NULL;
+static void *WiFiScan_arg = NULL;
+
+static void WiFiScan_finish(WiFiScanState_t state);
+
+typedef int (*WiFiScan_compare_t)(const WiFiDrvNetwork_t *a, const WiFiDrvNetwork_t *b);
+
+static int WiFiScan_compareRssi(const WiFiDrvNetwork_t *a, const WiFiDrvNetwork_t *b);
+
+static int WiFiScan_compareSsid(const WiFiDrvNetwork_t *a, const WiFiDrvNetwork_t *b);
+
+static void WiFiScan_sort(WiFiDrvNetwork_t *networks, uint8 count, WiFiScan_compare_t compare);
+
+
+int WiFiScan_scan(WiFiDrvNetwork_t *networks, uint8 max) {
+    int found = WiFi_scanNetworks();
+
+    if (found <= 0) {
+        return found;
+    }
+    return WiFiScan_results(networks, (found < max) ? found : max);
+}
+
+int WiFiScan_results(WiFiDrvNetwork_t *networks, uint8 count) {
+    return WiFiDrv_getNetworks(networks, count);
+}
+
+static void WiFiScan_finish(WiFiScanState_t state) {
+    WiFiScan_state = state;
+
+    if (WiFiScan_callback) {
+        WiFiScan_callback(state, WiFiScan_networks, WiFiScan_count, WiFiScan_arg);
+    }
+}
+
+int WiFiScan_start(TickType_t timeout, WiFiScanCallback_t callback, void *arg) {
+    WiFiScan_callback = callback;
+    WiFiScan_arg = arg;
+
+    if (WiFiDrv_startScanNetworks() == WL_FAILURE) {
+        WiFiScan_finish(WIFI_SCAN_FAILED);
+        return WL_FAILURE;
+    }
+
+    WiFiScan_delay = pdMS_TO_TICKS(WIFI_SCAN_POLL_MIN_MS);
+    if (WiFiScan_delay == 0) {
+        WiFiScan_delay = 1;
+    }
+
+    WiFiScan_started = xTaskGetTickCount();
+    WiFiScan_timeout = timeout;
+    WiFiScan_nextPoll = WiFiScan_started + WiFiScan_delay;
+    WiFiScan_state = WIFI_SCAN_RUNNING;
+    return WL_SUCCESS;
+}
+
+WiFiScanState_t WiFiScan_poll(void) {
+    TickType_t now = xTaskGetTickCount();
+
+    if (WiFiScan_state != WIFI_SCAN_RUNNING || (int32) (now - WiFiScan_nextPoll) < 0) {
+        return WiFiScan_state;
+    }
+
+    int found = WiFiDrv_getScanNetworks();
+    if (found > 0) {
+        WiFiScan_count = WiFiDrv_getNetworks(WiFiScan_networks, found);
+        WiFiScan_finish(WIFI_SCAN_COMPLETE);
+        return WiFiScan_state;
+    }
+
+    now = xTaskGetTickCount();
+    if (now - WiFiScan_started >= WiFiScan_timeout) {
+        // Whatever the last scan found is the best there is
+        WiFiScan_finish(WIFI_SCAN_TIMEOUT);
+        return WiFiScan_state;
+    }
+
+    WiFiScan_delay *= 2;
+    if (WiFiScan_delay > pdMS_TO_TICKS(WIFI_SCAN_POLL_MAX_MS)) {
+        WiFiScan_delay = pdMS_TO_TICKS(WIFI_SCAN_POLL_MAX_MS);
+    }
+    // The last check lands on the deadline, not after it
+    if (WiFiScan_delay > WiFiScan_timeout - (now - WiFiScan_started)) {
+        WiFiScan_nextPoll = WiFiScan_started + WiFiScan_timeout;
+    } else {
+        WiFiScan_nextPoll = now + WiFiScan_delay;
+    }
+    return WiFiScan_state;
+}
+
+int WiFiScan_scanWithin(WiFiDrvNetwork_t *networks, uint8 max, TickType_t timeout) {
+    if (WiFiScan_start(timeout, NULL, NULL) != WL_SUCCESS) {
+        return 0;
+    }
+
+    while (WiFiScan_poll() == WIFI_SCAN_RUNNING) {
+        TickType_t wait = WiFiScan_nextPoll - xTaskGetTickCount();
+        if ((int32) wait > 0) {
+            vTaskDelay(wait);
+        }
+    }
+
+    uint8 count = (WiFiScan_count < max) ? WiFiScan_count : max;
+    memcpy(networks, WiFiScan_networks, count * sizeof(WiFiDrvNetwork_t));
+    return count;
+}
+
+const WiFiDrvNetwork_t *WiFiScan_table(uint8 *count) {
+    *count = WiFiScan_count;
+    return WiFiScan_networks;
+}
+
+static int WiFiScan_compareRssi(const WiFiDrvNetwork_t *a, const WiFiDrvNetwork_t *b) {
+    return (a->rssi < b->rssi) - (a->rssi > b->rssi);
+}
+
+static int WiFiScan_compareSsid(const WiFiDrvNetwork_t *a, const WiFiDrvNetwork_t *b) {
+    int result = strcmp((const char *) a->ssid, (const char *) b->ssid);
+    return result ? result : WiFiScan_compareRssi(a, b);
+}
+
+// Insertion sort: the list is at most WL_NETWORKS_LIST_MAXNUM long and it keeps equal entries in order
+static void WiFiScan_sort(WiFiDrvNetwork_t *networks, uint8 count, WiFiScan_compare_t compare) {
+    for (uint8 i = 1; i < count; i++) {
+        WiFiDrvNetwork_t network = networks[i];
+        uint8 j = i;
+
+        while (j > 0 && compare(&networks[j - 1], &network) > 0) {
+            networks[j] = networks[j - 1];
+            j--;
+        }
+        networks[j] = network;
+    }
+}
+
+void WiFiScan_sortByRssi(WiFiDrvNetwork_t *networks, uint8 count) {
+    WiFiScan_sort(networks, count, WiFiScan_compareRssi);
+}
+
+void WiFiScan_sortBySsid(WiFiDrvNetwork_t *networks, uint8 count) {
+    WiFiScan_sort(networks, count, WiFiScan_compareSsid);
+}
+
+uint8 WiFiScan_filterRssi(WiFiDrvNetwork_t *networks, uint8 count, int32 minRssi) {
+    uint8 kept = 0;
+
+    for (uint8 i = 0; i < count; i++) {
+        if (networks[i].rssi >= minRssi) {
+            if (kept != i) {
+                networks[kept] = networks[i];
+            }
+            kept++;
+        }
+    }
+    return kept;
+}
+
+uint8 WiFiScan_filterSsid(WiFiDrvNetwork_t *networks, uint8 count, const uint8 *ssid) {
+    uint8 kept = 0;
+
+    for (uint8 i = 0; i < count; i++) {
+        if (!strcmp((const char *) networks[i].ssid, (const char *) ssid)) {
+            if (kept != i) {
+                networks[kept] = networks[i];
+            }
+            kept++;
+        }
+    }
+    return kept;
+}
+
+int WiFiScan_strongest(const WiFiDrvNetwork_t *networks, uint8 count, const uint8 *ssid) {
+    int best = -1;
+
+    for (uint8 i = 0; i < count; i++) {
+        if (strcmp((const char *) networks[i].ssid, (const char *) ssid)) {
+            continue;
+        }
+        if (best < 0 || networks[i].rssi > networks[best].rssi) {
+            best = i;
+        }
+    }
+    return best;
+}
@@ -0,0 +1,213 @@
+/*
+  WiFiServer.c - TCP servers for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "wl_definitions.h"
+#include "wifi_spi.h"
+#include "server_drv.h"
+#include "WiFiSocketBuffer.h"
+#include "WiFiSocket.h"
+
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include <string.h>
+
+typedef struct _WiFiServer {
+    uint8 listening;
+    WiFiSocketSet_t clients;
+    uint8 queue[WIFI_SERVER_ACCEPT_QUEUE];
+    uint8 head;
+    uint8 count;
+} WiFiServer_t;
+
+static WiFiServer_t WiFiServer_servers[WIFI_MAX_SOCK_NUM];
+
+static int WiFiServer_enqueue(WiFiServer_t *srv, uint8 _sock);
+
+static void WiFiServer_forget(WiFiServer_t *srv, uint8 _sock);
+
+
+int WiFiServer_begin(uint16 port) {
+    uint8 server = ServerDrv_getSocket();
+    if (server >= WIFI_MAX_SOCK_NUM) {
+        return NO_SOCKET_AVAIL;
+    }
+
+    if (ServerDrv_startServer(port, server, TCP_MODE) != 1) {
+        return NO_SOCKET_AVAIL;
+    }
+
+    memset(&WiFiServer_servers[server], 0x00, sizeof(WiFiServer_t));
+    WiFiServer_servers[server].listening = 1;
+    return server;
+}
+
+void WiFiServer_stop(uint8 server) {
+    if (server >= WIFI_MAX_SOCK_NUM) {
+        return;
+    }
+
+    memset(&WiFiServer_servers[server], 0x00, sizeof(WiFiServer_t));
+    ServerDrv_stopClient(server);
+}
+
+int WiFiServer_status(uint8 server) {
+    if (server >= WIFI_MAX_SOCK_NUM || !WiFiServer_servers[server].listening) {
+        return CLOSED;
+    }
+
+    return ServerDrv_getServerState(server);
+}
+
+static int WiFiServer_enqueue(WiFiServer_t *srv, uint8 _sock) {
+    if (srv->count >= WIFI_SERVER_ACCEPT_QUEUE) {
+        return 0;
+    }
+
+    srv->queue[(srv->head + srv->count) % WIFI_SERVER_ACCEPT_QUEUE] = _sock;
+    srv->count++;
+    srv->clients |= WIFI_SOCKET_BIT(_sock);
+    return 1;
+}
+
+static void WiFiServer_forget(WiFiServer_t *srv, uint8 _sock) {
+    uint8 count = srv->count;
+
+    srv->clients &= ~WIFI_SOCKET_BIT(_sock);
+
+    // Close the gap if it was still waiting to be accepted
+    srv->count = 0;
+    for (uint8 i = 0; i < count; i++) {
+        uint8 queued = srv->queue[(srv->head + i) % WIFI_SERVER_ACCEPT_QUEUE];
+        if (queued != _sock) {
+            srv->queue[(srv->head + srv->count) % WIFI_SERVER_ACCEPT_QUEUE] = queued;
+            srv->count++;
+        }
+    }
+}
+
+int WiFiServer_poll(uint8 server) {
+    if (server >= WIFI_MAX_SOCK_NUM || !WiFiServer_servers[server].listening) {
+        return 0;
+    }
+
+    WiFiServer_t *srv = &WiFiServer_servers[server];
+
+    // On a server socket this gives a client with data waiting, or 255 if there is none.  -1 is a failed query.
+    int _sock = ServerDrv_availData(server);
+    if (_sock >= 0 && _sock < WIFI_MAX_SOCK_NUM && _sock != server && !(srv->clients & WIFI_SOCKET_BIT(_sock))) {
+        // If the queue is full the client is left to be reported again on a later poll
+        WiFiServer_enqueue(srv, _sock);
+    }
+
+    if (srv->clients) {
+        // One batch for every client, then the rest is served from the table
+        WiFiSocket_refresh(srv->clients);
+
+        for (uint8 i = 0; i < WIFI_MAX_SOCK_NUM; i++) {
+            if (!(srv->clients & WIFI_SOCKET_BIT(i))) {
+                continue;
+            }
+
+            const WiFiSocketState_t *state = WiFiSocket_state(i);
+            if (state && state->tcpState == CLOSED && !state->available && !WiFiSocketBuffer_buffered(i)) {
+                WiFiServer_forget(srv, i);
+            }
+        }
+    }
+
+    return srv->count;
+}
+
+int WiFiServer_accept(uint8 server, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t delay = pdMS_TO_TICKS(WIFI_SOCKET_POLL_MIN_MS);
+    TickType_t maxDelay = pdMS_TO_TICKS(WIFI_SOCKET_POLL_MAX_MS);
+
+    if (server >= WIFI_MAX_SOCK_NUM || !WiFiServer_servers[server].listening) {
+        return NO_SOCKET_AVAIL;
+    }
+
+    if (delay == 0) {
+        delay = 1;
+    }
+
+    WiFiServer_t *srv = &WiFiServer_servers[server];
+
+    for (;;) {
+        if (srv->count || WiFiServer_poll(server)) {
+            uint8 _sock = srv->queue[srv->head];
+            srv->head = (srv->head + 1) % WIFI_SERVER_ACCEPT_QUEUE;
+            srv->count--;
+            return _sock;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return NO_SOCKET_AVAIL;
+        }
+
+        if (delay > timeout - elapsed) {
+            delay = timeout - elapsed;
+        }
+        vTaskDelay(delay);
+
+        delay *= 2;
+        if (delay > maxDelay) {
+            delay = maxDelay;
+        }
+    }
+}
+
+WiFiSocketSet_t WiFiServer_clients(uint8 server) {
+    if (server >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    return WiFiServer_servers[server].clients;
+}
+
+int WiFiServer_write(uint8 server, uint8 *buf, size_t size) {
+    int total = 0;
+
+    if (server >= WIFI_MAX_SOCK_NUM || !WiFiServer_servers[server].clients) {
+        return 0;
+    }
+
+    WiFiSocketSet_t clients = WiFiServer_servers[server].clients;
+
+    // Statuses below come from the table this refreshes
+    WiFiSocket_refresh(clients);
+
+    for (uint8 _sock = 0; _sock < WIFI_MAX_SOCK_NUM; _sock++) {
+        if ((clients & WIFI_SOCKET_BIT(_sock)) && WiFiClient_status(_sock) == ESTABLISHED) {
+            total += WiFiClient_write(_sock, buf, size);
+        }
+    }
+
+    return total;
+}
+
+int WiFiServer_writeChar(uint8 server, uint8 ch) {
+    return WiFiServer_write(server, &ch, 1);
+}
@@ -0,0 +1,180 @@
+/*
+  WiFiSocket.c - Socket readiness for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "server_drv.h"
+#include "wifi_spi.h"
+#include "WiFiSocketBuffer.h"
+#include "WiFiSocket.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#define WIFI_SOCKET_STATE_EVENTS (WIFI_SOCKET_WRITABLE | WIFI_SOCKET_CONNECTED | WIFI_SOCKET_CLOSED)
+
+static WiFiSocketState_t WiFiSocket_table[WIFI_MAX_SOCK_NUM];
+
+
+static uint8 WiFiSocket_stateEvents(uint8 state);
+
+static uint8 WiFiSocket_tableEvents(uint8 sock, uint8 events);
+
+
+static uint8 WiFiSocket_stateEvents(uint8 state) {
+    switch (state) {
+        case ESTABLISHED:
+            return WIFI_SOCKET_CONNECTED | WIFI_SOCKET_WRITABLE;
+        case CLOSE_WAIT:
+            // The peer is done sending, but we can still send
+            return WIFI_SOCKET_WRITABLE;
+        case CLOSED:
+            return WIFI_SOCKET_CLOSED;
+        default:
+            return 0;
+    }
+}
+
+WiFiSocketSet_t WiFiSocket_refresh(WiFiSocketSet_t set) {
+    uint8 socks[WIFI_MAX_SOCK_NUM];
+    uint8 states[WIFI_MAX_SOCK_NUM];
+    uint16 avail[WIFI_MAX_SOCK_NUM];
+    uint8 valid[WIFI_MAX_SOCK_NUM];
+    WiFiSocketSet_t refreshed = 0;
+    uint8 count = 0;
+
+    for (uint8 sock = 0; sock < WIFI_MAX_SOCK_NUM; sock++) {
+        if (set & WIFI_SOCKET_BIT(sock)) {
+            socks[count++] = sock;
+        }
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    if (!ServerDrv_getSocketStates(socks, count, states, avail, valid)) {
+        return 0;
+    }
+
+    TickType_t now = xTaskGetTickCount();
+    for (uint8 i = 0; i < count; i++) {
+        WiFiSocketState_t *entry = &WiFiSocket_table[socks[i]];
+
+        // A socket we got no answer for keeps whatever the table knew, rather than looking closed
+        if (!valid[i]) {
+            continue;
+        }
+
+        entry->tcpState = states[i];
+        entry->available = avail[i];
+        entry->updated = now;
+        entry->valid = 1;
+        refreshed |= WIFI_SOCKET_BIT(socks[i]);
+    }
+
+    return refreshed;
+}
+
+const WiFiSocketState_t *WiFiSocket_state(uint8 sock) {
+    if (sock >= WIFI_MAX_SOCK_NUM || !WiFiSocket_table[sock].valid) {
+        return NULL;
+    }
+
+    WiFiSocketState_t *entry = &WiFiSocket_table[sock];
+    if (xTaskGetTickCount() - entry->updated > pdMS_TO_TICKS(WIFI_SOCKET_STATE_MAX_AGE_MS)) {
+        return NULL;
+    }
+    return entry;
+}
+
+void WiFiSocket_invalidate(uint8 sock) {
+    if (sock < WIFI_MAX_SOCK_NUM) {
+        WiFiSocket_table[sock].valid = 0;
+    }
+}
+
+uint8 WiFiSocket_events(uint8 sock, uint8 events) {
+    if (sock >= WIFI_MAX_SOCK_NUM) {
+        return WIFI_SOCKET_CLOSED & events;
+    }
+
+    if (!WiFiSocket_state(sock)) {
+        WiFiSocket_refresh(WIFI_SOCKET_BIT(sock));
+    }
+
+    return WiFiSocket_tableEvents(sock, events);
+}
+
+static uint8 WiFiSocket_tableEvents(uint8 sock, uint8 events) {
+    const WiFiSocketState_t *state = &WiFiSocket_table[sock];
+    uint8 result = 0;
+
+    // Never heard back about this socket, so there is nothing to report yet
+    if (!state->valid) {
+        return 0;
+    }
+
+    if ((events & WIFI_SOCKET_READABLE) && (WiFiSocketBuffer_buffered(sock) || state->available)) {
+        result |= WIFI_SOCKET_READABLE;
+    }
+
+    if (events & WIFI_SOCKET_STATE_EVENTS) {
+        result |= WiFiSocket_stateEvents(state->tcpState);
+    }
+
+    return result & events;
+}
+
+WiFiSocketSet_t WiFiSocket_wait(WiFiSocketSet_t set, uint8 events, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+    TickType_t delay = pdMS_TO_TICKS(WIFI_SOCKET_POLL_MIN_MS);
+    TickType_t maxDelay = pdMS_TO_TICKS(WIFI_SOCKET_POLL_MAX_MS);
+
+    if (delay == 0) {
+        delay = 1;
+    }
+
+    for (;;) {
+        WiFiSocketSet_t ready = 0;
+
+        // One batch for the whole set, then everything below is served from the table
+        WiFiSocket_refresh(set);
+
+        for (uint8 sock = 0; sock < WIFI_MAX_SOCK_NUM; sock++) {
+            if ((set & WIFI_SOCKET_BIT(sock)) && WiFiSocket_tableEvents(sock, events)) {
+                ready |= WIFI_SOCKET_BIT(sock);
+            }
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (ready || elapsed >= timeout) {
+            return ready;
+        }
+
+        if (delay > timeout - elapsed) {
+            delay = timeout - elapsed;
+        }
+        vTaskDelay(delay);
+
+        delay *= 2;
+        if (delay > maxDelay) {
+            delay = maxDelay;
+        }
+    }
+}
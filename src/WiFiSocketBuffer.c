@@ -22,16 +22,230 @@
 #include "server_drv.h"
 #include "spi_drv.h"
 #include "WiFiSocketBuffer.h"
+#include "WiFiSocket.h"
+#include "WiFiTask.h"
 #include "FreeRTOS.h"
-#include <stdlib.h>
+#include "task.h"
+#include <stdint.h>
+#include <string.h>
+
+#if WIFI_SOCKET_BUFFER_POOL_SIZE > 32
+#error "WIFI_SOCKET_BUFFER_POOL_SIZE must fit in the 32-bit free mask"
+#endif
 
 static WiFiSocketBuffer_t _buffers[WIFI_MAX_SOCK_NUM];
 
 #define WIFI_SOCKET_NUM_BUFFERS (sizeof(_buffers) / sizeof(_buffers[0]))
 
+static uint8 _pool[WIFI_SOCKET_BUFFER_POOL_SIZE][WIFI_SOCKET_BUFFER_SIZE];
+static uint32 _poolUsed = 0;
+static WiFiSocketBufferPoolStats_t _poolStats;
+
+static void WiFiSocketBuffer_release(int socket);
+static uint16 WiFiSocketBuffer_depth(int socket);
+static int WiFiSocketBuffer_claim(int socket);
+static void WiFiSocketBuffer_unclaim(int socket);
+static int WiFiSocketBuffer_fill(int socket);
+static int WiFiSocketBuffer_prefetchHandler(void *arg);
+static void WiFiSocketBuffer_schedulePrefetch(int socket);
+static void WiFiSocketBuffer_consume(int socket, uint8 *data, size_t length);
+static int WiFiSocketBuffer_wait(int socket, TickType_t start, TickType_t timeout);
+static void WiFiSocketBuffer_settle(int socket);
+
 
 void WiFiSocketBuffer_init(void) {
     memset(&_buffers[0], 0x00, sizeof(_buffers));
+
+    taskENTER_CRITICAL();
+    _poolUsed = 0;
+    memset(&_poolStats, 0x00, sizeof(_poolStats));
+    taskEXIT_CRITICAL();
+}
+
+uint8 *WiFiSocketBuffer_poolGet(void) {
+    uint8 *data = NULL;
+
+    taskENTER_CRITICAL();
+    for (uint8 i = 0; i < WIFI_SOCKET_BUFFER_POOL_SIZE; i++) {
+        if (!(_poolUsed & (1UL << i))) {
+            _poolUsed |= (1UL << i);
+            data = _pool[i];
+
+            if (++_poolStats.inUse > _poolStats.highWater) {
+                _poolStats.highWater = _poolStats.inUse;
+            }
+            break;
+        }
+    }
+    if (!data) {
+        _poolStats.failures++;
+    }
+    taskEXIT_CRITICAL();
+
+    return data;
+}
+
+void WiFiSocketBuffer_poolPut(uint8 *data) {
+    uint8 i = (data - _pool[0]) / WIFI_SOCKET_BUFFER_SIZE;
+
+    taskENTER_CRITICAL();
+    _poolUsed &= ~(1UL << i);
+    _poolStats.inUse--;
+    taskEXIT_CRITICAL();
+}
+
+// Hand the buffer back as soon as it's empty so idle sockets don't tie up the pool
+static void WiFiSocketBuffer_release(int socket) {
+    WiFiSocketBuffer_t *buffer = &_buffers[socket];
+    uint8 *data = NULL;
+
+    taskENTER_CRITICAL();
+    // A prefetch in flight owns the buffer, it gets released when that finishes
+    if (!buffer->fetching && buffer->length == 0) {
+        data = buffer->data;
+        buffer->data = NULL;
+        buffer->head = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    if (data) {
+        WiFiSocketBuffer_poolPut(data);
+    }
+}
+
+static uint16 WiFiSocketBuffer_depth(int socket) {
+    return _buffers[socket].size ? _buffers[socket].size : WIFI_SOCKET_BUFFER_SIZE;
+}
+
+// Only one fetch per socket at a time, whether it's from the reader or the I/O task
+static int WiFiSocketBuffer_claim(int socket) {
+    int claimed = 0;
+
+    taskENTER_CRITICAL();
+    if (!_buffers[socket].fetching && !_buffers[socket].closed) {
+        _buffers[socket].fetching = 1;
+        claimed = 1;
+    }
+    taskEXIT_CRITICAL();
+
+    return claimed;
+}
+
+static void WiFiSocketBuffer_unclaim(int socket) {
+    taskENTER_CRITICAL();
+    _buffers[socket].fetching = 0;
+    if (_buffers[socket].closed) {
+        // Closed while fetching, whatever came in belongs to the old connection
+        _buffers[socket].closed = 0;
+        _buffers[socket].length = 0;
+    }
+    taskEXIT_CRITICAL();
+
+    WiFiSocketBuffer_release(socket);
+}
+
+/*
+ * Fetch into the free space after the staged data.  Must hold the claim.  Only one contiguous
+ * stretch is filled, GET_DATABUF_TCP_CMD can't wrap around the end of the ring.
+ */
+static int WiFiSocketBuffer_fill(int socket) {
+    WiFiSocketBuffer_t *buffer = &_buffers[socket];
+    uint16 depth = WiFiSocketBuffer_depth(socket);
+    uint16 tail;
+
+    // Closed since the claim was taken, nothing more belongs in the ring
+    if (buffer->closed) {
+        return 0;
+    }
+
+    if (buffer->data == NULL) {
+        buffer->data = WiFiSocketBuffer_poolGet();
+        if (buffer->data == NULL) {
+            // Pool exhausted, the data stays on the co-processor until a buffer frees up
+            return 0;
+        }
+        buffer->head = 0;
+    }
+
+    taskENTER_CRITICAL();
+    if (buffer->length == 0) {
+        // Empty, so start over at the front and get the whole ring in one fetch
+        buffer->head = 0;
+    }
+    tail = (buffer->head + buffer->length) % depth;
+    taskEXIT_CRITICAL();
+
+    if (buffer->length == depth) {
+        return 0;
+    }
+
+    // sizeof(size_t) is architecture dependent
+    // but we need a 16 bit data type here
+    uint16 size = (tail >= buffer->head) ? depth - tail : buffer->head - tail;
+    if (!ServerDrv_getDataBuf(socket, buffer->data + tail, &size) || !size) {
+        return 0;
+    }
+
+    taskENTER_CRITICAL();
+    if (buffer->closed) {
+        // Closed while we were fetching, this belongs to the old connection
+        size = 0;
+    }
+    buffer->length += size;
+    taskEXIT_CRITICAL();
+
+    return size;
+}
+
+static int WiFiSocketBuffer_prefetchHandler(void *arg) {
+    int socket = (int) (intptr_t) arg;
+    int size = WiFiSocketBuffer_fill(socket);
+
+    WiFiSocketBuffer_unclaim(socket);
+    WiFiSocket_invalidate(socket);
+    return size;
+}
+
+// Queue the next chunk on the I/O task so the reader doesn't have to wait for it
+static void WiFiSocketBuffer_schedulePrefetch(int socket) {
+    WiFiSocketBuffer_t *buffer = &_buffers[socket];
+
+    if (!WiFiTask_running()) {
+        return;
+    }
+
+    // Don't spend a transfer on a socket the table already says is dry
+    const WiFiSocketState_t *state = WiFiSocket_state(socket);
+    if (state && state->available == 0) {
+        return;
+    }
+
+    if (!WiFiSocketBuffer_claim(socket)) {
+        return;
+    }
+
+    buffer->prefetchOp.handler = WiFiSocketBuffer_prefetchHandler;
+    buffer->prefetchOp.arg = (void *) (intptr_t) socket;
+    buffer->prefetchOp.notify = NULL;
+    buffer->prefetchOp.callback = NULL;
+    buffer->prefetchOp.context = NULL;
+
+    if (!WiFiTask_submit(&buffer->prefetchOp, 0)) {
+        WiFiSocketBuffer_unclaim(socket);
+    }
+}
+
+void WiFiSocketBuffer_getPoolStats(WiFiSocketBufferPoolStats_t *stats) {
+    taskENTER_CRITICAL();
+    *stats = _poolStats;
+    taskEXIT_CRITICAL();
+}
+
+void WiFiSocketBuffer_resetPoolStats(void) {
+    taskENTER_CRITICAL();
+    _poolStats.highWater = _poolStats.inUse;
+    _poolStats.failures = 0;
+    taskEXIT_CRITICAL();
 }
 
 void WiFiSocketBuffer_deinit(void) {
@@ -41,27 +255,71 @@ void WiFiSocketBuffer_deinit(void) {
 }
 
 void WiFiSocketBuffer_close(int socket) {
+    taskENTER_CRITICAL();
+    _buffers[socket].length = 0;
+    if (_buffers[socket].fetching) {
+        _buffers[socket].closed = 1;
+    }
+    taskEXIT_CRITICAL();
+
+    WiFiSocketBuffer_release(socket);
+}
+
+int WiFiSocketBuffer_setDepth(int socket, uint16 size, uint16 lowWater) {
     if (_buffers[socket].data) {
-        free(_buffers[socket].data);
-        _buffers[socket].data = _buffers[socket].head = NULL;
-        _buffers[socket].length = 0;
+        return 0;
+    }
+
+    if (size > WIFI_SOCKET_BUFFER_SIZE) {
+        size = WIFI_SOCKET_BUFFER_SIZE;
+    }
+    _buffers[socket].size = size;
+    _buffers[socket].lowWater = lowWater;
+    return 1;
+}
+
+// Let a fetch in flight on another task land, as long as it's not waiting on us to get the bus or the I/O task
+static void WiFiSocketBuffer_settle(int socket) {
+    TickType_t start = xTaskGetTickCount();
+
+    if (WiFiTask_current() || SpiDrv_ownsBus()) {
+        return;
+    }
+
+    while (_buffers[socket].fetching && _buffers[socket].length == 0 &&
+           xTaskGetTickCount() - start < pdMS_TO_TICKS(WIFI_SOCKET_BUFFER_FETCH_WAIT_MS)) {
+        vTaskDelay(1);
     }
 }
 
 int WiFiSocketBuffer_available(int socket) {
-    if (_buffers[socket].length == 0) {
-        if (_buffers[socket].data == NULL) {
-            _buffers[socket].data = _buffers[socket].head = (uint8 *) malloc(WIFI_SOCKET_BUFFER_SIZE);
-            _buffers[socket].length = 0;
-        }
+    if (_buffers[socket].length == 0 && _buffers[socket].fetching) {
+        WiFiSocketBuffer_settle(socket);
+    }
 
-        // sizeof(size_t) is architecture dependent
-        // but we need a 16 bit data type here
-        uint16 size = WIFI_SOCKET_BUFFER_SIZE;
-        if (ServerDrv_getDataBuf(socket, _buffers[socket].data, &size)) {
-            _buffers[socket].head = _buffers[socket].data;
-            _buffers[socket].length = size;
-        }
+    if (_buffers[socket].length == 0 && WiFiSocketBuffer_claim(socket)) {
+        WiFiSocketBuffer_fill(socket);
+        WiFiSocketBuffer_unclaim(socket);
+    }
+
+    return _buffers[socket].length;
+}
+
+// What is already staged, without going to the co-processor for more
+int WiFiSocketBuffer_buffered(int socket) {
+    return _buffers[socket].length;
+}
+
+int WiFiSocketBuffer_fetching(int socket) {
+    return _buffers[socket].fetching;
+}
+
+int WiFiSocketBuffer_prefetch(int socket) {
+    uint16 lowWater = _buffers[socket].lowWater ? _buffers[socket].lowWater : WIFI_SOCKET_BUFFER_LOW_WATER;
+
+    if (_buffers[socket].length < lowWater && WiFiSocketBuffer_claim(socket)) {
+        WiFiSocketBuffer_fill(socket);
+        WiFiSocketBuffer_unclaim(socket);
     }
 
     return _buffers[socket].length;
@@ -72,7 +330,36 @@ int WiFiSocketBuffer_peek(int socket) {
         return -1;
     }
 
-    return *_buffers[socket].head;
+    return _buffers[socket].data[_buffers[socket].head];
+}
+
+// Take length staged bytes off the ring.  data may be NULL to just drop them.
+static void WiFiSocketBuffer_consume(int socket, uint8 *data, size_t length) {
+    WiFiSocketBuffer_t *buffer = &_buffers[socket];
+    uint16 depth = WiFiSocketBuffer_depth(socket);
+    uint16 lowWater = buffer->lowWater ? buffer->lowWater : WIFI_SOCKET_BUFFER_LOW_WATER;
+
+    // Staged data may wrap around the end of the ring.  A prefetch only ever appends past it.
+    if (data) {
+        size_t first = depth - buffer->head;
+        if (first > length) {
+            first = length;
+        }
+        memcpy(data, buffer->data + buffer->head, first);
+        memcpy(data + first, buffer->data, length - first);
+    }
+
+    taskENTER_CRITICAL();
+    buffer->head = (buffer->head + length) % depth;
+    buffer->length -= length;
+    taskEXIT_CRITICAL();
+
+    if (buffer->length < lowWater) {
+        WiFiSocketBuffer_schedulePrefetch(socket);
+    }
+    if (!buffer->length) {
+        WiFiSocketBuffer_release(socket);
+    }
 }
 
 int WiFiSocketBuffer_read(int socket, uint8 *data, size_t length) {
@@ -86,9 +373,128 @@ int WiFiSocketBuffer_read(int socket, uint8 *data, size_t length) {
         length = avail;
     }
 
-    memcpy(data, _buffers[socket].head, length);
-    _buffers[socket].head += length;
-    _buffers[socket].length -= length;
-
+    WiFiSocketBuffer_consume(socket, data, length);
     return length;
 }
+
+int WiFiSocketBuffer_readInto(int socket, uint8 *data, size_t length) {
+    int total = 0;
+
+    // Whatever is already staged goes first to keep the stream in order
+    if (_buffers[socket].length) {
+        total = WiFiSocketBuffer_read(socket, data, length);
+        data += total;
+        length -= total;
+    }
+
+    if (length < WIFI_SOCKET_DIRECT_READ_MIN) {
+        if (total || !length) {
+            return total;
+        }
+        return WiFiSocketBuffer_read(socket, data, length);
+    }
+
+    // Hold the claim so no prefetch can start and land in the ring ahead of what we read here
+    if (_buffers[socket].length || !WiFiSocketBuffer_claim(socket)) {
+        return total;
+    }
+
+    // A prefetch may have finished between the check and the claim
+    if (_buffers[socket].length) {
+        WiFiSocketBuffer_unclaim(socket);
+        return total;
+    }
+
+    uint16 size = (length > WIFI_SOCKET_BUFFER_SIZE) ? WIFI_SOCKET_BUFFER_SIZE : length;
+    if (ServerDrv_getDataBuf(socket, data, &size) && !_buffers[socket].closed) {
+        total += size;
+    }
+    WiFiSocketBuffer_unclaim(socket);
+
+    return total;
+}
+
+// Wait for more data if any of the timeout is left.  Returns 0 once it has run out.
+static int WiFiSocketBuffer_wait(int socket, TickType_t start, TickType_t timeout) {
+    TickType_t elapsed = xTaskGetTickCount() - start;
+
+    if (elapsed >= timeout) {
+        return 0;
+    }
+
+    WiFiSocket_wait(WIFI_SOCKET_BIT(socket), WIFI_SOCKET_READABLE, timeout - elapsed);
+    return 1;
+}
+
+int WiFiSocketBuffer_readUntil(int socket, uint8 delim, uint8 *data, size_t length, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+    size_t total = 0;
+
+    while (total < length) {
+        if (!WiFiSocketBuffer_available(socket)) {
+            if (!WiFiSocketBuffer_wait(socket, start, timeout)) {
+                break;
+            }
+            continue;
+        }
+
+        // Search the staged bytes up to the end of the ring in one go rather than byte by byte
+        WiFiSocketBuffer_t *buffer = &_buffers[socket];
+        size_t span = WiFiSocketBuffer_depth(socket) - buffer->head;
+        if (span > buffer->length) {
+            span = buffer->length;
+        }
+        if (span > length - total) {
+            span = length - total;
+        }
+
+        uint8 *found = memchr(buffer->data + buffer->head, delim, span);
+        if (found) {
+            span = found - (buffer->data + buffer->head) + 1;
+        }
+
+        WiFiSocketBuffer_consume(socket, data + total, span);
+        total += span;
+
+        if (found) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+int WiFiSocketBuffer_readLine(int socket, char *line, size_t length, TickType_t timeout) {
+    if (!length) {
+        return -1;
+    }
+
+    int len = WiFiSocketBuffer_readUntil(socket, '\n', (uint8 *) line, length - 1, timeout);
+    int complete = (len && line[len - 1] == '\n');
+
+    if (complete) {
+        len--;
+        if (len && line[len - 1] == '\r') {
+            len--;
+        }
+    }
+    line[len] = '\0';
+
+    return complete ? len : -1;
+}
+
+int WiFiSocketBuffer_readExact(int socket, uint8 *data, size_t length, TickType_t timeout) {
+    TickType_t start = xTaskGetTickCount();
+    size_t total = 0;
+
+    while (total < length) {
+        int len = WiFiSocketBuffer_readInto(socket, data + total, length - total);
+        if (len) {
+            total += len;
+        } else if (!WiFiSocketBuffer_wait(socket, start, timeout)) {
+            break;
+        }
+    }
+
+    return total;
+}
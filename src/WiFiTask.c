@@ -0,0 +1,138 @@
+/*
+  WiFiTask.c - Optional network I/O task for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "spi_drv.h"
+#include "WiFiTask.h"
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#if WIFI_TASK_NOTIFY_INDEX >= configTASK_NOTIFICATION_ARRAY_ENTRIES
+#error "WIFI_TASK_NOTIFY_INDEX needs configTASK_NOTIFICATION_ARRAY_ENTRIES above it"
+#endif
+
+static QueueHandle_t WiFiTask_queue = NULL;
+static TaskHandle_t WiFiTask_handle = NULL;
+
+
+static void WiFiTask_main(void *param);
+
+static void WiFiTask_complete(WiFiTaskOp_t *op);
+
+
+static void WiFiTask_complete(WiFiTaskOp_t *op) {
+    TaskHandle_t notify = op->notify;
+    UBaseType_t notifyIndex = op->notifyIndex;
+
+    op->result = op->handler(op->arg);
+
+    if (op->callback) {
+        op->callback(op);
+    }
+
+    // The waiting task may reuse op as soon as it wakes, so this has to come last
+    if (notify) {
+        xTaskNotifyGiveIndexed(notify, notifyIndex);
+    }
+}
+
+static void WiFiTask_main(void *param) {
+    WiFiTaskOp_t *op;
+
+    (void) param;
+
+    for (;;) {
+        xQueueReceive(WiFiTask_queue, &op, portMAX_DELAY);
+
+        // Each operation runs without interruption, but other tasks get the bus in between operations
+        SpiDrv_lockBus(portMAX_DELAY);
+        WiFiTask_complete(op);
+        SpiDrv_unlockBus();
+    }
+}
+
+int WiFiTask_start(UBaseType_t priority, uint16 stackDepth) {
+    if (WiFiTask_handle) {
+        return 1;
+    }
+
+    WiFiTask_queue = xQueueCreate(WIFI_TASK_QUEUE_LENGTH, sizeof(WiFiTaskOp_t *));
+    if (WiFiTask_queue == NULL) {
+        return 0;
+    }
+
+    return xTaskCreate(WiFiTask_main, "WiFi I/O", stackDepth, NULL, priority, &WiFiTask_handle) == pdPASS;
+}
+
+int WiFiTask_running(void) {
+    return WiFiTask_handle != NULL;
+}
+
+int WiFiTask_current(void) {
+    return WiFiTask_handle != NULL && xTaskGetCurrentTaskHandle() == WiFiTask_handle;
+}
+
+int WiFiTask_submit(WiFiTaskOp_t *op, TickType_t timeout) {
+    if (!WiFiTask_queue) {
+        return 0;
+    }
+    return xQueueSendToBack(WiFiTask_queue, &op, timeout) == pdTRUE;
+}
+
+int WiFiTask_submitUrgent(WiFiTaskOp_t *op, TickType_t timeout) {
+    if (!WiFiTask_queue) {
+        return 0;
+    }
+    return xQueueSendToFront(WiFiTask_queue, &op, timeout) == pdTRUE;
+}
+
+int WiFiTask_call(WiFiTaskHandler_t handler, void *arg) {
+    WiFiTaskOp_t op = {handler, arg, 0, NULL, NULL, NULL, WIFI_TASK_NOTIFY_INDEX};
+
+    if (!WiFiTask_handle || WiFiTask_current()) {
+        return handler(arg);
+    }
+
+    op.notify = xTaskGetCurrentTaskHandle();
+    if (!WiFiTask_submit(&op, portMAX_DELAY)) {
+        return handler(arg);
+    }
+
+    ulTaskNotifyTakeIndexed(WIFI_TASK_NOTIFY_INDEX, pdTRUE, portMAX_DELAY);
+    return op.result;
+}
+
+int WiFiTask_async(WiFiTaskOp_t *op, WiFiTaskHandler_t handler, void *arg, TaskHandle_t notify,
+                   WiFiTaskCallback_t callback, void *context) {
+    op->handler = handler;
+    op->arg = arg;
+    op->result = 0;
+    op->notify = notify;
+    op->callback = callback;
+    op->context = context;
+    op->notifyIndex = 0;
+
+    if (!WiFiTask_handle) {
+        WiFiTask_complete(op);
+        return 1;
+    }
+    return WiFiTask_submit(op, 0);
+}
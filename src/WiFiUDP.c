@@ -0,0 +1,366 @@
+/*
+  WiFiUDP.c - UDP sockets for the WiFiNINA library ported to C.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "wl_definitions.h"
+#include "server_drv.h"
+#include "spi_drv.h"
+#include "wifi_drv.h"
+#include "WiFiSocketBuffer.h"
+
+#include "WiFi.h"
+#include "WiFiUDP.h"
+
+#include <string.h>
+
+typedef struct _WiFiUDPSocket {
+    // The datagram being read: staged bytes, and any left on the co-processor
+    uint8 *rxData;
+    uint16 rxHead;
+    uint16 rxLength;
+    uint16 rxRemaining;
+
+    uint32 remoteIp;
+    uint16 remotePort;
+    uint8 remoteValid;
+
+    // The datagram being built, txFailed once part of it could not be passed on
+    uint8 *txData;
+    uint16 txLength;
+    uint8 txFailed;
+} WiFiUDPSocket_t;
+
+static WiFiUDPSocket_t WiFiUDP_sockets[WIFI_MAX_SOCK_NUM];
+
+static int WiFiUDP_open(uint8 _sock);
+
+static void WiFiUDP_dropPacket(uint8 _sock);
+
+static int WiFiUDP_insert(uint8 _sock);
+
+static void WiFiUDP_getRemote(uint8 _sock);
+
+
+static int WiFiUDP_open(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return NO_SOCKET_AVAIL;
+    }
+
+    memset(&WiFiUDP_sockets[_sock], 0x00, sizeof(WiFiUDPSocket_t));
+    return _sock;
+}
+
+int WiFiUDP_begin(uint16 port) {
+    uint8 _sock = ServerDrv_getSocket();
+    if (_sock == NO_SOCKET_AVAIL) {
+        return _sock;
+    }
+
+    if (ServerDrv_startServer(port, _sock, UDP_MODE) != 1) {
+        return NO_SOCKET_AVAIL;
+    }
+    return WiFiUDP_open(_sock);
+}
+
+int WiFiUDP_beginMulticast(uint32 ip, uint16 port) {
+    uint8 _sock = ServerDrv_getSocket();
+    if (_sock == NO_SOCKET_AVAIL) {
+        return _sock;
+    }
+
+    if (ServerDrv_startServerIpAddress(ip, port, _sock, UDP_MULTICAST_MODE) != 1) {
+        return NO_SOCKET_AVAIL;
+    }
+    return WiFiUDP_open(_sock);
+}
+
+void WiFiUDP_stop(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return;
+    }
+
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+
+    if (udp->rxData) {
+        WiFiSocketBuffer_poolPut(udp->rxData);
+    }
+    if (udp->txData) {
+        WiFiSocketBuffer_poolPut(udp->txData);
+    }
+    memset(udp, 0x00, sizeof(WiFiUDPSocket_t));
+
+    ServerDrv_stopClient(_sock);
+}
+
+int WiFiUDP_beginPacket(uint8 _sock, uint32 ip, uint16 port) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+
+    if (ServerDrv_startClient(ip, port, _sock, UDP_MODE) != 1) {
+        return 0;
+    }
+
+    // Without a staging buffer writes still work, each one is just its own transfer
+    if (!udp->txData) {
+        udp->txData = WiFiSocketBuffer_poolGet();
+    }
+    udp->txLength = 0;
+    udp->txFailed = 0;
+    return 1;
+}
+
+int WiFiUDP_beginPacketHostname(uint8 _sock, uint8 *host, uint16 port) {
+    uint32 remote_addr;
+    if (WiFi_hostByName(host, &remote_addr)) {
+        return WiFiUDP_beginPacket(_sock, remote_addr, port);
+    }
+    return 0;
+}
+
+// Pass what has been staged on to the co-processor's datagram
+static int WiFiUDP_insert(uint8 _sock) {
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+    int result = 1;
+
+    if (udp->txLength) {
+        result = ServerDrv_insertDataBuf(_sock, udp->txData, udp->txLength);
+        udp->txLength = 0;
+    }
+    return result;
+}
+
+int WiFiUDP_write(uint8 _sock, uint8 *buf, size_t size) {
+    if (_sock >= WIFI_MAX_SOCK_NUM || size == 0) {
+        return 0;
+    }
+
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+    int total = 0;
+
+    // Part of the datagram is already missing, don't go on as if it weren't
+    if (udp->txFailed) {
+        return 0;
+    }
+
+    while (size > 0) {
+        uint16 space = WIFI_SOCKET_BUFFER_SIZE - udp->txLength;
+
+        if (!udp->txData || (!udp->txLength && size >= WIFI_SOCKET_BUFFER_SIZE)) {
+            // Nothing to batch with, send it straight from the caller's buffer
+            uint16 chunk = (size > WIFI_SOCKET_BUFFER_SIZE) ? WIFI_SOCKET_BUFFER_SIZE : size;
+            if (!ServerDrv_insertDataBuf(_sock, buf, chunk)) {
+                udp->txFailed = 1;
+                break;
+            }
+            total += chunk;
+            buf += chunk;
+            size -= chunk;
+            continue;
+        }
+
+        uint16 chunk = (size > space) ? space : size;
+        memcpy(udp->txData + udp->txLength, buf, chunk);
+        udp->txLength += chunk;
+        total += chunk;
+        buf += chunk;
+        size -= chunk;
+
+        if (udp->txLength == WIFI_SOCKET_BUFFER_SIZE && !WiFiUDP_insert(_sock)) {
+            // Only this chunk came from this call, anything staged before it was already counted
+            total -= chunk;
+            udp->txFailed = 1;
+            break;
+        }
+    }
+
+    return total;
+}
+
+int WiFiUDP_writeChar(uint8 _sock, uint8 ch) {
+    return WiFiUDP_write(_sock, &ch, 1);
+}
+
+int WiFiUDP_endPacket(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+    int result = !udp->txFailed && WiFiUDP_insert(_sock);
+
+    if (udp->txData) {
+        WiFiSocketBuffer_poolPut(udp->txData);
+        udp->txData = NULL;
+    }
+
+    if (!result) {
+        return 0;
+    }
+    return ServerDrv_sendUdpData(_sock);
+}
+
+// The co-processor only moves on to the next datagram once the current one is read out
+static void WiFiUDP_dropPacket(uint8 _sock) {
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+    uint8 scratch[64];
+
+    while (udp->rxRemaining) {
+        uint16 size = (udp->rxRemaining > sizeof(scratch)) ? sizeof(scratch) : udp->rxRemaining;
+        if (!ServerDrv_getDataBuf(_sock, scratch, &size) || !size) {
+            break;
+        }
+        udp->rxRemaining -= size;
+    }
+
+    if (udp->rxData) {
+        WiFiSocketBuffer_poolPut(udp->rxData);
+        udp->rxData = NULL;
+    }
+    udp->rxHead = 0;
+    udp->rxLength = 0;
+    udp->rxRemaining = 0;
+    udp->remoteValid = 0;
+}
+
+int WiFiUDP_parsePacket(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+
+    WiFiUDP_dropPacket(_sock);
+
+    int size = ServerDrv_availData(_sock);
+    if (size <= 0) {
+        return 0;
+    }
+    udp->rxRemaining = size;
+
+    // Stage the whole datagram so reading it costs no more transfers
+    if (size <= WIFI_SOCKET_BUFFER_SIZE) {
+        udp->rxData = WiFiSocketBuffer_poolGet();
+        if (udp->rxData) {
+            uint16 len = size;
+            if (ServerDrv_getDataBuf(_sock, udp->rxData, &len)) {
+                udp->rxLength = len;
+                udp->rxRemaining -= len;
+            }
+        }
+    }
+
+    return size;
+}
+
+int WiFiUDP_available(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    return WiFiUDP_sockets[_sock].rxLength + WiFiUDP_sockets[_sock].rxRemaining;
+}
+
+int WiFiUDP_read(uint8 _sock, uint8 *buf, size_t size) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+    int total = 0;
+
+    if (udp->rxLength) {
+        total = (size > udp->rxLength) ? udp->rxLength : size;
+        memcpy(buf, udp->rxData + udp->rxHead, total);
+        udp->rxHead += total;
+        udp->rxLength -= total;
+        buf += total;
+        size -= total;
+    }
+
+    // Whatever didn't fit in a pool buffer comes straight from the co-processor
+    if (size && udp->rxRemaining) {
+        uint16 len = (size > udp->rxRemaining) ? udp->rxRemaining : size;
+        if (ServerDrv_getDataBuf(_sock, buf, &len)) {
+            udp->rxRemaining -= len;
+            total += len;
+        }
+    }
+
+    return total;
+}
+
+int WiFiUDP_readChar(uint8 _sock) {
+    uint8 ch;
+
+    if (WiFiUDP_read(_sock, &ch, sizeof(ch)) != 1) {
+        return -1;
+    }
+    return ch;
+}
+
+int WiFiUDP_peek(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return -1;
+    }
+
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+
+    if (udp->rxLength) {
+        return udp->rxData[udp->rxHead];
+    }
+    if (udp->rxRemaining) {
+        uint8 ch;
+        if (ServerDrv_getData(_sock, &ch, 1)) {
+            return ch;
+        }
+    }
+    return -1;
+}
+
+// One query gets both, and only once per datagram
+static void WiFiUDP_getRemote(uint8 _sock) {
+    WiFiUDPSocket_t *udp = &WiFiUDP_sockets[_sock];
+
+    if (!udp->remoteValid) {
+        udp->remoteIp = 0;
+        udp->remotePort = 0;
+        udp->remoteValid = WiFiDrv_getRemoteData(_sock, &udp->remoteIp, &udp->remotePort) ? 1 : 0;
+    }
+}
+
+uint32 WiFiUDP_remoteIP(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    WiFiUDP_getRemote(_sock);
+    return WiFiUDP_sockets[_sock].remoteIp;
+}
+
+uint16 WiFiUDP_remotePort(uint8 _sock) {
+    if (_sock >= WIFI_MAX_SOCK_NUM) {
+        return 0;
+    }
+
+    WiFiUDP_getRemote(_sock);
+    return WiFiUDP_sockets[_sock].remotePort;
+}
@@ -156,6 +156,41 @@ int ServerDrv_getClientState(uint8 sock) {
     return _data;
 }
 
+int ServerDrv_getSocketStates(uint8 *socks, uint8 count, uint8 *states, uint16 *avail, uint8 *valid) {
+    tParam inParams[WIFI_MAX_SOCK_NUM];
+    tParam outParams[2 * WIFI_MAX_SOCK_NUM];
+    SpiDrvCmd_t cmds[2 * WIFI_MAX_SOCK_NUM];
+    int answered = 0;
+
+    if (count > WIFI_MAX_SOCK_NUM) {
+        count = WIFI_MAX_SOCK_NUM;
+    }
+
+    // The firmware has no multi-socket query, so this is two commands per socket run back to back
+    for (int i = 0; i < count; i++) {
+        states[i] = CLOSED;
+        avail[i] = 0;
+        inParams[i].paramLen = 1;
+        inParams[i].param = &socks[i];
+        outParams[2 * i].paramLen = 1;
+        outParams[2 * i].param = &states[i];
+        outParams[2 * i + 1].paramLen = 2;
+        outParams[2 * i + 1].param = &avail[i];
+        cmds[2 * i] = (SpiDrvCmd_t) {GET_CLIENT_STATE_TCP_CMD, 1, &inParams[i], 16, 1, &outParams[2 * i], 0, 0};
+        cmds[2 * i + 1] = (SpiDrvCmd_t) {AVAIL_DATA_TCP_CMD, 1, &inParams[i], 20, 1, &outParams[2 * i + 1], 0, 0};
+    }
+
+    SpiDrv_runCommands(cmds, 2 * count);
+
+    for (int i = 0; i < count; i++) {
+        valid[i] = cmds[2 * i].result && cmds[2 * i + 1].result;
+        if (valid[i]) {
+            answered++;
+        }
+    }
+    return answered;
+}
+
 int ServerDrv_availData(uint8 sock) {
     uint16 _data = 0;
     tParam inParams[] = {{1, &sock}};
@@ -166,7 +201,9 @@ int ServerDrv_availData(uint8 sock) {
     SpiDrv_sendCmd(AVAIL_DATA_TCP_CMD, 1, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(AVAIL_DATA_TCP_CMD, 20, &paramsRead, outParams, 1);
+    if (!SpiDrv_receiveResponseCmd(AVAIL_DATA_TCP_CMD, 20, &paramsRead, outParams, 1)) {
+        return -1;
+    }
     return _data;
 }
 
@@ -174,14 +211,16 @@ int ServerDrv_availData(uint8 sock) {
 int ServerDrv_getData(uint8 sock, uint8 *data, uint8 peek) {
     tParam inParams[] = {{1, &sock},
                          {1, &peek}};
-    tParam outParams[] = {{WIFI_SOCKET_BUFFER_SIZE, &data}};
+    tParam outParams[] = {{1, data}};
     uint8 paramsRead;
 
     // Send Command
-    SpiDrv_sendCmd(GET_DATA_TCP_CMD, 1, inParams);
+    SpiDrv_sendCmd(GET_DATA_TCP_CMD, 2, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(GET_DATA_TCP_CMD, WIFI_SOCKET_BUFFER_SIZE, &paramsRead, outParams, 1);
+    if (!SpiDrv_receiveResponseCmd(GET_DATA_TCP_CMD, 16, &paramsRead, outParams, 1)) {
+        return 0;
+    }
     return outParams[0].paramLen;
 }
 
@@ -195,23 +234,29 @@ int ServerDrv_getDataBuf(uint8 sock, uint8 *_data, uint16 *_dataLen) {
     SpiDrv_sendBuffer(GET_DATABUF_TCP_CMD, 2, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseBuffer(GET_DATABUF_TCP_CMD, WIFI_SOCKET_BUFFER_SIZE, &paramsRead, outParams, 1);
-    return outParams[0].dataLen;
+    // Reply is the header, a 16 bit length, the data and END_CMD
+    if (!SpiDrv_receiveResponseBuffer(GET_DATABUF_TCP_CMD, *_dataLen + 6, &paramsRead, outParams, 1)) {
+        return 0;
+    }
+
+    // Callers go by *_dataLen, which was the size asked for until now
+    *_dataLen = outParams[0].dataLen;
+    return *_dataLen;
 }
 
 int ServerDrv_insertDataBuf(uint8 sock, uint8 *data, uint16 _len) {
-    int16 response = 0;
+    uint8 response = 0;
     tDataParam inParams[] = {{1,    &sock},
                              {_len, data}};
-    tDataParam outParams[] = {{2, &response}};
+    tParam outParams[] = {{1, &response}};
     uint8 paramsRead;
 
     // Send Command
     SpiDrv_sendBuffer(INSERT_DATABUF_CMD, 2, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseBuffer(INSERT_DATABUF_CMD, 20, &paramsRead, outParams, 1);
-    if (outParams[0].dataLen == 0) {
+    // The reply is an ordinary command reply with an 8 bit length, not a buffer reply
+    if (!SpiDrv_receiveResponseCmd(INSERT_DATABUF_CMD, 20, &paramsRead, outParams, 1) || outParams[0].paramLen == 0) {
         return 0;
     }
     return (response == 1);
@@ -227,50 +272,61 @@ int ServerDrv_sendUdpData(uint8 sock) {
     SpiDrv_sendCmd(SEND_DATA_UDP_CMD, 1, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(SEND_DATA_UDP_CMD, 20, &paramsRead, outParams, 1);
-    if (outParams[0].paramLen == 0) {
+    if (!SpiDrv_receiveResponseCmd(SEND_DATA_UDP_CMD, 20, &paramsRead, outParams, 1) || outParams[0].paramLen == 0) {
         return 0;
     }
     return (response == 1);
 }
 
 int ServerDrv_sendData(uint8 sock, uint8 *data, uint16 len) {
-    uint8 response = 0;
+    uint16 response = 0;
     tDataParam inParams[] = {{1,   &sock},
                              {len, data}};
-    tParam outParams[] = {{1, &response}};
+    tParam outParams[] = {{2, &response}};
     uint8 paramsRead;
 
     // Send Command
     SpiDrv_sendBuffer(SEND_DATA_TCP_CMD, 2, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(SEND_DATA_TCP_CMD, 20, &paramsRead, outParams, 1);
+    if (!SpiDrv_receiveResponseCmd(SEND_DATA_TCP_CMD, 20, &paramsRead, outParams, 1)) {
+        return 0;
+    }
     return response;
 }
 
 int ServerDrv_checkDataSent(uint8 sock) {
-    uint16 TIMEOUT_DATA_SENT = 25;
-    uint16 timeout = 0;
+    TickType_t start = xTaskGetTickCount();
+    TickType_t delay = 1;
     uint8 response = 0;
     tParam inParams[] = {{1, &sock}};
     tParam outParams[] = {{1, &response}};
     uint8 paramsRead;
 
-    do {
+    for (;;) {
         // Send Command
         SpiDrv_sendCmd(DATA_SENT_TCP_CMD, 1, inParams);
 
         // Wait for reply
         SpiDrv_receiveResponseCmd(DATA_SENT_TCP_CMD, 20, &paramsRead, outParams, 1);
         if (response) {
-            timeout = 0;
-        } else {
-            ++timeout;
-            vTaskDelay(pdMS_TO_TICKS(100));
+            return 1;
         }
-    } while ((response == 0) && (timeout < TIMEOUT_DATA_SENT));
-    return (timeout != TIMEOUT_DATA_SENT);
+
+        if (xTaskGetTickCount() - start >= pdMS_TO_TICKS(DATA_SENT_TIMEOUT_MS)) {
+            return 0;
+        }
+
+        // Not under the bus lock, so this one is only approximate
+        SPI_DRV_STATS_ADD(dataSentRetries, 1);
+
+        // Usually done almost at once, so check again quickly and back off from there
+        vTaskDelay(delay);
+        delay *= 2;
+        if (delay > pdMS_TO_TICKS(100)) {
+            delay = pdMS_TO_TICKS(100);
+        }
+    }
 }
 
 int ServerDrv_getSocket() {
@@ -283,6 +339,9 @@ int ServerDrv_getSocket() {
     SpiDrv_sendCmd(GET_SOCKET_CMD, 0, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(GET_SOCKET_CMD, 20, &paramsRead, outParams, 1);
+    if (!SpiDrv_receiveResponseCmd(GET_SOCKET_CMD, 20, &paramsRead, outParams, 1)) {
+        // 0 is a perfectly good socket, so don't let it through
+        return NO_SOCKET_AVAIL;
+    }
     return response;
 }
@@ -0,0 +1,155 @@
+/*
+  spi_dma.c - DMA transport for the WiFiNINA SPI driver.
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "spi_drv.h"
+#include "spi_dma.h"
+
+#ifdef WIFI_SPI_DMA
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include <string.h>
+
+extern SemaphoreHandle_t spiTxCompleted;
+
+// The bus address the DMA controller sees for a buffer or register.  A host build maps its pointers here.
+#ifndef SPI_DMA_ADDRESS
+#define SPI_DMA_ADDRESS(ptr) ((uint32) (ptr))
+#endif
+
+static uint8 SpiDma_initialized = 0;
+static uint8 SpiDma_txChannel;
+static uint8 SpiDma_rxChannel;
+static uint8 SpiDma_txTd;
+static uint8 SpiDma_rxTd[2];
+
+// Ping-pong receive buffers: the DMA fills one while we copy the other out
+static uint8 SpiDma_rxBuffer[2][SPI_DMA_CHUNK_SIZE];
+
+// Ping-pong transmit buffers for data outside SRAM (flash constants): we fill one while the DMA sends the other
+static uint8 SpiDma_txBuffer[2][SPI_DMA_CHUNK_SIZE];
+
+// Clocked out when there is nothing to send.  Kept in SRAM as the Tx channel only addresses SRAM.
+static uint8 SpiDma_dummy = 0;
+
+
+static void SpiDma_begin(void);
+
+static void SpiDma_transfer(const uint8 *tx, uint8 *rx, uint16 len);
+
+static void SpiDma_startChunk(const uint8 *tx, uint8 bank, uint16 len);
+
+static uint8 SpiDma_inSram(const uint8 *buf, uint16 len);
+
+const SpiTransport_t SpiDma_transport = {SpiDma_begin, SpiDma_transfer};
+
+
+// The Rx descriptor completes once every byte of the chunk has been clocked in
+CY_ISR(SpiDma_rxDoneIsr) {
+    BaseType_t preempted = pdFALSE;
+    xSemaphoreGiveFromISR(spiTxCompleted, &preempted);
+    portYIELD_FROM_ISR(preempted);
+}
+
+static void SpiDma_begin(void) {
+    if (SpiDma_initialized) {
+        return;
+    }
+
+    SpiDma_txChannel = DMA_WIFI_TX_DmaInitialize(1, 1, HI16(CYDEV_SRAM_BASE), HI16(CYDEV_PERIPH_BASE));
+    SpiDma_rxChannel = DMA_WIFI_RX_DmaInitialize(1, 1, HI16(CYDEV_PERIPH_BASE), HI16(CYDEV_SRAM_BASE));
+
+    SpiDma_txTd = CyDmaTdAllocate();
+    SpiDma_rxTd[0] = CyDmaTdAllocate();
+    SpiDma_rxTd[1] = CyDmaTdAllocate();
+
+    isr_WIFI_DMA_RX_StartEx(SpiDma_rxDoneIsr);
+
+    SpiDma_initialized = 1;
+}
+
+static uint8 SpiDma_inSram(const uint8 *buf, uint16 len) {
+    uint32 start = SPI_DMA_ADDRESS(buf);
+    uint32 end = start + len - 1;
+
+    // The Tx channel's upper address is fixed to the bottom of SRAM, so anything else is copied in first
+    return start >= CYDEV_SRAM_BASE && end < CYDEV_SRAM_BASE + CYDEV_SRAM_SIZE &&
+           HI16(start) == HI16(CYDEV_SRAM_BASE) && HI16(end) == HI16(CYDEV_SRAM_BASE);
+}
+
+static void SpiDma_startChunk(const uint8 *tx, uint8 bank, uint16 len) {
+    // Arm the receive side first so no byte can slip past it
+    CyDmaTdSetConfiguration(SpiDma_rxTd[bank], len, CY_DMA_DISABLE_TD, TD_INC_DST_ADR | DMA_WIFI_RX__TD_TERMOUT_EN);
+    CyDmaTdSetAddress(SpiDma_rxTd[bank], LO16(SPI_DMA_ADDRESS(SPIM_WIFI_RXDATA_PTR)),
+                      LO16(SPI_DMA_ADDRESS(SpiDma_rxBuffer[bank])));
+    CyDmaChSetInitialTd(SpiDma_rxChannel, SpiDma_rxTd[bank]);
+    CyDmaChEnable(SpiDma_rxChannel, 1);
+
+    CyDmaTdSetConfiguration(SpiDma_txTd, len, CY_DMA_DISABLE_TD, tx ? TD_INC_SRC_ADR : 0);
+    CyDmaTdSetAddress(SpiDma_txTd, LO16(SPI_DMA_ADDRESS(tx ? tx : &SpiDma_dummy)),
+                      LO16(SPI_DMA_ADDRESS(SPIM_WIFI_TXDATA_PTR)));
+    CyDmaChSetInitialTd(SpiDma_txChannel, SpiDma_txTd);
+    CyDmaChEnable(SpiDma_txChannel, 1);
+}
+
+static void SpiDma_transfer(const uint8 *tx, uint8 *rx, uint16 len) {
+    uint8 *pending = NULL;
+    uint16 pendingLen = 0;
+    uint8 bank = 0;
+    uint8 bounce = tx && len && !SpiDma_inSram(tx, len);
+
+    if (bounce) {
+        memcpy(SpiDma_txBuffer[bank], tx, (len > SPI_DMA_CHUNK_SIZE) ? SPI_DMA_CHUNK_SIZE : len);
+    }
+
+    while (len > 0) {
+        uint16 chunk = (len > SPI_DMA_CHUNK_SIZE) ? SPI_DMA_CHUNK_SIZE : len;
+
+        SpiDma_startChunk(bounce ? SpiDma_txBuffer[bank] : tx, bank, chunk);
+
+        // Copy out the previous chunk, and stage the next one to send, while this one is on the wire
+        if (pending) {
+            memcpy(pending, SpiDma_rxBuffer[bank ^ 1], pendingLen);
+        }
+        if (bounce && len > chunk) {
+            uint16 next = len - chunk;
+            memcpy(SpiDma_txBuffer[bank ^ 1], tx + chunk, (next > SPI_DMA_CHUNK_SIZE) ? SPI_DMA_CHUNK_SIZE : next);
+        }
+
+        xSemaphoreTake(spiTxCompleted, portMAX_DELAY);
+
+        pending = rx;
+        pendingLen = chunk;
+        if (rx) {
+            rx += chunk;
+        }
+        if (tx) {
+            tx += chunk;
+        }
+        len -= chunk;
+        bank ^= 1;
+    }
+
+    if (pending) {
+        memcpy(pending, SpiDma_rxBuffer[bank ^ 1], pendingLen);
+    }
+}
+
+#endif
@@ -26,21 +26,87 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "semphr.h"
+#include <string.h>
 
 SemaphoreHandle_t slaveReadyDetected;
 SemaphoreHandle_t spiTxCompleted;
 BaseType_t spiTxPreempted;
 
 #define SPI_MAX_TX_BUFFER 255   // hope there are no responses or commands bigger.
-#define SPI_MAX_RX_BUFFER 255   // hope there are no responses or commands bigger.
+#define SPI_MAX_RX_BUFFER 255   // largest single SPIM transfer, longer ones are split into chunks of this size
+
+// Replies with parameters up to this size are clocked in together with the length or END byte that follows them
+#define SPI_SMALL_PARAM_SIZE 16
 
 static int SpiDrv_initialized = 0;
 static uint8 txBuffer[SPI_MAX_TX_BUFFER];
 
+// Bus ownership.  A FreeRTOS mutex gives us priority inheritance; nesting is counted here.
+static SemaphoreHandle_t SpiDrv_busMutex = NULL;
+static TaskHandle_t SpiDrv_busOwner = NULL;
+static UBaseType_t SpiDrv_busDepth = 0;
+
+// Unfortunately, to receive, we must transmit.  This is what we transmit (all zeros).
+static const uint8 dummyBuffer[SPI_MAX_RX_BUFFER] = {0};
+
 
 static int SpiDrv_waitSpiChar(uint8 waitChar);
 
-static int SpiDrv_readAndCheckChar(uint8 checkChar, uint8 *readChar);
+static void SpiDrv_transfer(const uint8 *tx, uint8 *rx, uint16 len);
+
+static void SpiDrv_byteTransfer(const uint8 *tx, uint8 *rx, uint16 len);
+
+static uint16 SpiDrv_buildCmd(uint8 *buffer, uint8 cmd, uint8 numParam, tParam *params);
+
+static void SpiDrv_sendFrame(uint8 *buffer, uint16 len);
+
+static int SpiDrv_receiveResponse(uint8 cmd, uint16 maxSize, uint8 lenSize, uint8 *numParamRead, tDataParam *params,
+                                  uint8 maxNumParams);
+
+static int SpiDrv_readResponse(uint8 cmd, uint16 maxSize, uint8 lenSize, uint8 *numParamRead, tDataParam *params,
+                               uint8 maxNumParams);
+
+// Default transport: push through the SPIM software buffers, pull back one byte at a time
+const SpiTransport_t SpiDrv_byteTransport = {NULL, SpiDrv_byteTransfer};
+
+static const SpiTransport_t *SpiDrv_transport = &SpiDrv_byteTransport;
+
+#ifdef WIFI_SPI_STATS
+SpiDrvStats_t SpiDrv_stats;
+
+// Only the opcodes the drivers send get counters, rather than all 128
+static const uint8 SpiDrv_statsCmds[] = {
+        SET_NET_CMD, SET_PASSPHRASE_CMD, SET_KEY_CMD, SET_IP_CONFIG_CMD, SET_DNS_CONFIG_CMD, SET_HOSTNAME_CMD,
+        SET_POWER_MODE_CMD, SET_AP_NET_CMD, SET_AP_PASSPHRASE_CMD, SET_DEBUG_CMD, GET_TEMPERATURE_CMD,
+        GET_CONN_STATUS_CMD, GET_IPADDR_CMD, GET_MACADDR_CMD, GET_CURR_SSID_CMD, GET_CURR_BSSID_CMD,
+        GET_CURR_RSSI_CMD, GET_CURR_ENCT_CMD, SCAN_NETWORKS, START_SERVER_TCP_CMD, GET_STATE_TCP_CMD,
+        DATA_SENT_TCP_CMD, AVAIL_DATA_TCP_CMD, GET_DATA_TCP_CMD, START_CLIENT_TCP_CMD, STOP_CLIENT_TCP_CMD,
+        GET_CLIENT_STATE_TCP_CMD, DISCONNECT_CMD, GET_IDX_RSSI_CMD, GET_IDX_ENCT_CMD, REQ_HOST_BY_NAME_CMD,
+        GET_HOST_BY_NAME_CMD, START_SCAN_NETWORKS, GET_FW_VERSION_CMD, SEND_DATA_UDP_CMD, GET_REMOTE_DATA_CMD,
+        GET_TIME_CMD, GET_IDX_BSSID, GET_IDX_CHANNEL_CMD, PING_CMD, GET_SOCKET_CMD, SEND_DATA_TCP_CMD,
+        GET_DATABUF_TCP_CMD, INSERT_DATABUF_CMD, SET_PIN_MODE, SET_DIGITAL_WRITE, SET_ANALOG_WRITE,
+};
+
+#define SPI_DRV_STATS_NUM_CMDS (sizeof(SpiDrv_statsCmds) / sizeof(SpiDrv_statsCmds[0]))
+
+static SpiDrvCmdStats_t SpiDrv_cmdStats[SPI_DRV_STATS_NUM_CMDS];
+
+// The command whose reply is awaited, NULL if it isn't one we count, and when it went out
+static SpiDrvCmdStats_t *SpiDrv_statsCmd;
+static uint32 SpiDrv_statsStart;
+
+static SpiDrvCmdStats_t *SpiDrv_statsFind(uint8 cmd);
+
+static void SpiDrv_statsSend(uint8 cmd);
+
+static void SpiDrv_statsReply(uint8 cmd, int result);
+
+#define SPI_DRV_STATS_SEND(cmd)           SpiDrv_statsSend(cmd)
+#define SPI_DRV_STATS_REPLY(cmd, result)  SpiDrv_statsReply(cmd, result)
+#else
+#define SPI_DRV_STATS_SEND(cmd)           do {} while (0)
+#define SPI_DRV_STATS_REPLY(cmd, result)  do {} while (0)
+#endif
 
 // PSoC interrupt on falling edge of ESPBUSY - triggers a FreeRTOS semaphore
 void ESP_BUSY_IRQ_Interrupt_InterruptCallback(void) {
@@ -52,6 +118,10 @@ void ESP_BUSY_IRQ_Interrupt_InterruptCallback(void) {
 // PSoC interrupt fpr SPI Tx.  We only care when transfer is complete
 void SPIM_WIFI_TX_ISR_EntryCallback(void) {
     spiTxPreempted = pdFALSE;
+    if (SpiDrv_transport != &SpiDrv_byteTransport) {
+        // Another transport signals completion itself
+        return;
+    }
     if ((SPIM_WIFI_STATUS & SPIM_WIFI_STATUS_MASK) & SPIM_WIFI_INT_ON_SPI_DONE) {
         xSemaphoreGiveFromISR(spiTxCompleted, &spiTxPreempted);
     }
@@ -62,7 +132,22 @@ void SPIM_WIFI_TX_ISR_ExitCallback(void) {
 }
 
 void SpiDrv_begin(void) {
-    slaveReadyDetected = xSemaphoreCreateBinary();
+    if (slaveReadyDetected == NULL) {
+        slaveReadyDetected = xSemaphoreCreateBinary();
+    }
+    if (spiTxCompleted == NULL) {
+        spiTxCompleted = xSemaphoreCreateBinary();
+    }
+    if (SpiDrv_busMutex == NULL) {
+        SpiDrv_busMutex = xSemaphoreCreateMutex();
+    }
+
+    // Nobody else gets a command in while the chip is being reset
+    SpiDrv_lockBus(portMAX_DELAY);
+
+    if (SpiDrv_transport->begin) {
+        SpiDrv_transport->begin();
+    }
 
     ESPRST_Write(1);
     vTaskDelay(pdMS_TO_TICKS(10));
@@ -72,6 +157,130 @@ void SpiDrv_begin(void) {
     vTaskDelay(pdMS_TO_TICKS(750));
 
     SpiDrv_initialized = 1;
+
+    SpiDrv_unlockBus();
+}
+
+int SpiDrv_lockBus(TickType_t timeout) {
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+
+    // Not set up yet.  SpiDrv_begin() has to be the one to do it, so it only ever happens once.
+    if (SpiDrv_busMutex == NULL) {
+        return 0;
+    }
+
+    if (SpiDrv_busOwner == self) {
+        SpiDrv_busDepth++;
+        return 1;
+    }
+
+    if (xSemaphoreTake(SpiDrv_busMutex, timeout) != pdTRUE) {
+        return 0;
+    }
+
+    SpiDrv_busOwner = self;
+    SpiDrv_busDepth = 1;
+    return 1;
+}
+
+void SpiDrv_unlockBus(void) {
+    if (SpiDrv_busOwner != xTaskGetCurrentTaskHandle()) {
+        return;
+    }
+
+    if (--SpiDrv_busDepth == 0) {
+        SpiDrv_busOwner = NULL;
+        xSemaphoreGive(SpiDrv_busMutex);
+    }
+}
+
+int SpiDrv_ownsBus(void) {
+    return SpiDrv_busOwner == xTaskGetCurrentTaskHandle();
+}
+
+#ifdef WIFI_SPI_STATS
+static SpiDrvCmdStats_t *SpiDrv_statsFind(uint8 cmd) {
+    cmd &= ~(REPLY_FLAG);
+
+    for (uint8 i = 0; i < SPI_DRV_STATS_NUM_CMDS; i++) {
+        if (SpiDrv_statsCmds[i] == cmd) {
+            return &SpiDrv_cmdStats[i];
+        }
+    }
+    return NULL;
+}
+
+static void SpiDrv_statsSend(uint8 cmd) {
+    SpiDrv_statsCmd = SpiDrv_statsFind(cmd);
+    if (SpiDrv_statsCmd) {
+        SpiDrv_statsCmd->count++;
+    }
+    SpiDrv_statsStart = WIFI_SPI_STATS_TIMESTAMP();
+}
+
+static void SpiDrv_statsReply(uint8 cmd, int result) {
+    SpiDrvCmdStats_t *stats = SpiDrv_statsCmd;
+    uint32 elapsed = WIFI_SPI_STATS_TIMESTAMP() - SpiDrv_statsStart;
+    uint8 bucket = 0;
+
+    (void) cmd;
+    if (!stats) {
+        return;
+    }
+
+    while (elapsed && bucket < WIFI_SPI_STATS_BUCKETS - 1) {
+        elapsed >>= 1;
+        bucket++;
+    }
+    stats->latency[bucket]++;
+
+    if (!result) {
+        stats->failures++;
+    }
+}
+
+void SpiDrv_getStats(SpiDrvStats_t *stats) {
+    int locked = SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS));
+
+    memcpy(stats, &SpiDrv_stats, sizeof(SpiDrvStats_t));
+
+    if (locked) {
+        SpiDrv_unlockBus();
+    }
+}
+
+int SpiDrv_getCmdStats(uint8 cmd, SpiDrvCmdStats_t *stats) {
+    SpiDrvCmdStats_t *found = SpiDrv_statsFind(cmd);
+    int locked;
+
+    if (!found) {
+        return 0;
+    }
+
+    locked = SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS));
+
+    memcpy(stats, found, sizeof(SpiDrvCmdStats_t));
+
+    if (locked) {
+        SpiDrv_unlockBus();
+    }
+    return 1;
+}
+
+void SpiDrv_resetStats(void) {
+    int locked = SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS));
+
+    memset(&SpiDrv_stats, 0x00, sizeof(SpiDrvStats_t));
+    memset(SpiDrv_cmdStats, 0x00, sizeof(SpiDrv_cmdStats));
+
+    if (locked) {
+        SpiDrv_unlockBus();
+    }
+}
+#endif
+
+void SpiDrv_setTransport(const SpiTransport_t *transport) {
+    SpiDrv_transport = transport ? transport : &SpiDrv_byteTransport;
 }
 
 void SpiDrv_end(void) {
@@ -105,6 +314,7 @@ static int SpiDrv_waitSpiChar(uint8 waitChar) {
     uint8 _readChar = 0;
     do {
         _readChar = SpiDrv_readChar(); //get data byte
+        SPI_DRV_STATS_ADD(waitCharSpins, 1);
         if (_readChar == ERR_CMD) {
             return -1;
         }
@@ -112,16 +322,45 @@ static int SpiDrv_waitSpiChar(uint8 waitChar) {
     return (_readChar == waitChar);
 }
 
-static int SpiDrv_readAndCheckChar(uint8 checkChar, uint8 *readChar) {
-    *readChar = SpiDrv_readChar();
-    return (*readChar == checkChar);
+uint8 SpiDrv_readChar() {
+    uint8 _data = 0;
+    SpiDrv_transfer(NULL, &_data, 1);
+    return _data;
 }
 
-uint8 SpiDrv_readChar() {
-    if (SPIM_WIFI_GetRxBufferSize() == 0) {
-        return 0;
+static void SpiDrv_transfer(const uint8 *tx, uint8 *rx, uint16 len) {
+#ifdef WIFI_SPI_STATS
+    // Frames go out with a tx buffer, replies are clocked in with zeros
+    if (tx) {
+        SpiDrv_stats.bytesSent += len;
+    } else {
+        SpiDrv_stats.bytesReceived += len;
+    }
+#endif
+    SpiDrv_transport->transfer(tx, rx, len);
+}
+
+// Clock len bytes over the bus.  A NULL tx sends zeros, a NULL rx throws away what comes back.
+static void SpiDrv_byteTransfer(const uint8 *tx, uint8 *rx, uint16 len) {
+    while (len > 0) {
+        uint8 chunk = (len > SPI_MAX_RX_BUFFER) ? SPI_MAX_RX_BUFFER : len;
+
+        SPIM_WIFI_ClearRxBuffer();
+        SPIM_WIFI_PutArray(tx ? tx : dummyBuffer, chunk);
+        xSemaphoreTake(spiTxCompleted, portMAX_DELAY);
+
+        // The data will come into the rx buffer as we Tx, so let's pull from it.
+        if (rx) {
+            for (int i = 0; i < chunk && SPIM_WIFI_GetRxBufferSize(); i++) {
+                *rx++ = SPIM_WIFI_ReadRxData();
+            }
+        }
+
+        if (tx) {
+            tx += chunk;
+        }
+        len -= chunk;
     }
-    return SPIM_WIFI_ReadRxData();
 }
 
 void SpiDrv_waitForSlaveReady() {
@@ -133,13 +372,38 @@ void SpiDrv_waitForSlaveReady() {
 
 void SpiDrv_waitForSlaveReadyTimeout(TickType_t timeout) {
     if (ESPBUSY_Read()) {
+#ifdef WIFI_SPI_STATS
+        uint32 start = WIFI_SPI_STATS_TIMESTAMP();
         xSemaphoreTake(slaveReadyDetected, timeout);
+        SpiDrv_stats.busyWaitTime += WIFI_SPI_STATS_TIMESTAMP() - start;
+#else
+        xSemaphoreTake(slaveReadyDetected, timeout);
+#endif
     }
 }
 
-void SpiDrv_sendBuffer(uint8 cmd, uint8 numParam, tDataParam *params) {
+/*
+ * Only the frame header, parameter lengths and small parameters are built in txBuffer.  Larger payloads are
+ * clocked out straight from the caller's buffer (the DMA transport bounces anything outside SRAM itself).
+ */
+int SpiDrv_sendBuffer(uint8 cmd, uint8 numParam, tDataParam *params) {
     int i;
     int j;
+    uint16 sent = 0;
+
+    // Released once the matching response has been read
+    if (!SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS))) {
+        return 0;
+    }
+
+    // Make sure the TX and RX buffer are cleared
+    SPIM_WIFI_ClearTxBuffer();
+    SPIM_WIFI_ClearRxBuffer();
+
+    SPI_DRV_STATS_SEND(cmd);
+
+    // The frame goes out in pieces while the slave stays selected
+    SpiDrv_waitForSlaveSelect();
 
     txBuffer[0] = START_CMD;
     txBuffer[1] = cmd & ~(REPLY_FLAG);
@@ -149,86 +413,46 @@ void SpiDrv_sendBuffer(uint8 cmd, uint8 numParam, tDataParam *params) {
     for (i = 0, j = 3; i < numParam; i++) {
         tDataParam *param = &params[i];
         uint16 len = param->dataLen;
+
+        if (j + 2 + SPI_SMALL_PARAM_SIZE > SPI_MAX_TX_BUFFER) {
+            SpiDrv_transfer(txBuffer, NULL, j);
+            sent += j;
+            j = 0;
+        }
         txBuffer[j++] = (len >> 8) & 0xFF;
         txBuffer[j++] = len & 0xFF;
-        memcpy(&txBuffer[j], param->data, len);
-        j += len;
+
+        if (len <= SPI_SMALL_PARAM_SIZE) {
+            memcpy(&txBuffer[j], param->data, len);
+            j += len;
+        } else {
+            SpiDrv_transfer(txBuffer, NULL, j);
+            SpiDrv_transfer(param->data, NULL, len);
+            sent += j + len;
+            j = 0;
+        }
+    }
+
+    // Room for the padding and END_CMD
+    if (j + 4 > SPI_MAX_TX_BUFFER) {
+        SpiDrv_transfer(txBuffer, NULL, j);
+        sent += j;
+        j = 0;
     }
 
     // Want a total buffer length of integer multiple of 32
-    while ((j & 3) != 3) {
+    while (((sent + j) & 3) != 3) {
         txBuffer[j++] = 0;
     }
     txBuffer[j++] = END_CMD;
 
-    // Make sure the TX and RX buffer are cleared
-    SPIM_WIFI_ClearTxBuffer();
-    SPIM_WIFI_ClearRxBuffer();
-
-    SpiDrv_waitForSlaveSelect();
-    SPIM_WIFI_PutArray(txBuffer, j);
-    xSemaphoreTake(spiTxCompleted, portMAX_DELAY);
+    SpiDrv_transfer(txBuffer, NULL, j);
     SpiDrv_spiSlaveDeselect();
+    return 1;
 }
 
 int SpiDrv_receiveResponseBuffer(uint8 cmd, uint16 maxSize, uint8 *numParamRead, tDataParam *params, uint8 maxNumParams) {
-    uint8 _data = 0;
-
-    if (maxSize > SPI_MAX_RX_BUFFER) {
-        maxSize = SPI_MAX_RX_BUFFER;
-    }
-
-    // Make sure the TX and RX buffer are cleared
-    SPIM_WIFI_ClearTxBuffer();
-    SPIM_WIFI_ClearRxBuffer();
-
-    // Wait the reply elaboration
-    SpiDrv_waitForSlaveSelect();
-
-    // Unfortunately, to receive, we must transmit.  Transmit all zeros.
-    memset(txBuffer, 0, maxSize);
-    SPIM_WIFI_PutArray(txBuffer, maxSize);
-    xSemaphoreTake(spiTxCompleted, portMAX_DELAY);
-    SpiDrv_spiSlaveDeselect();
-
-    // The data will come into the rx buffer as we Tx, so let's pull from it.
-    if (!SpiDrv_waitSpiChar(START_CMD)) {
-        return 0;
-    }
-
-    if (!SpiDrv_readAndCheckChar(cmd | REPLY_FLAG, &_data)) {
-        return 0;
-    }
-
-    uint8 numParam = SpiDrv_readChar();
-
-    if (numParam > maxNumParams) {
-        numParam = maxNumParams;
-    }
-
-    *numParamRead = numParam;
-    if (numParam == 0) {
-        return 0;
-    }
-
-    for (int i = 0; i < numParam; ++i) {
-        tDataParam *param = &params[i];
-        uint8 *buf = param->data;
-        uint16 len = ((SpiDrv_readChar() & 0xFF) << 8);
-        len |= (SpiDrv_readChar() & 0xFF);
-
-        if (len >= param->dataLen) {
-            len = param->dataLen - 1;
-        }
-
-        for (int j = 0; j < len; j++) {
-            *buf++ = SpiDrv_readChar();
-        }
-        *buf = 0;
-        param->dataLen = len;
-    }
-
-    return SpiDrv_readAndCheckChar(END_CMD, &_data);
+    return SpiDrv_receiveResponse(cmd, maxSize, 2, numParamRead, params, maxNumParams);
 }
 
 /* Cmd Struct Message */
@@ -238,44 +462,111 @@ int SpiDrv_receiveResponseBuffer(uint8 cmd, uint16 maxSize, uint8 *numParamRead,
 /*|   8 bit   | 1bit | 7bit |  8bit   |  8bit   |   8bit    | nbytes | .. |   8bit  | */
 /*|___________|______|______|_________|_________|___________|________|____|_________| */
 
-void SpiDrv_sendCmd(uint8 cmd, uint8 numParam, tParam *params) {
+static uint16 SpiDrv_buildCmd(uint8 *buffer, uint8 cmd, uint8 numParam, tParam *params) {
     int i;
     int j;
 
-    txBuffer[0] = START_CMD;
-    txBuffer[1] = cmd & ~(REPLY_FLAG);
+    buffer[0] = START_CMD;
+    buffer[1] = cmd & ~(REPLY_FLAG);
     // totlen seems to not be used
-    txBuffer[2] = numParam;
+    buffer[2] = numParam;
 
     for (i = 0, j = 3; i < numParam; i++) {
         tParam *param = &params[i];
         uint8 len = param->paramLen;
-        txBuffer[j++] = len;
-        memcpy(&txBuffer[j], param->param, len);
+        buffer[j++] = len;
+        memcpy(&buffer[j], param->param, len);
         j += len;
     }
 
     // Want a total buffer length of integer multiple of 32
     while ((j & 3) != 3) {
-        txBuffer[j++] = 0;
+        buffer[j++] = 0;
     }
-    txBuffer[j++] = END_CMD;
+    buffer[j++] = END_CMD;
 
+    return j;
+}
+
+static void SpiDrv_sendFrame(uint8 *buffer, uint16 len) {
     // Make sure the TX and RX buffer are cleared
     SPIM_WIFI_ClearTxBuffer();
     SPIM_WIFI_ClearRxBuffer();
 
+    SPI_DRV_STATS_SEND(buffer[1]);
+
     SpiDrv_waitForSlaveSelect();
-    SPIM_WIFI_PutArray(txBuffer, j);
-    xSemaphoreTake(spiTxCompleted, portMAX_DELAY);
+    SpiDrv_transfer(buffer, NULL, len);
     SpiDrv_spiSlaveDeselect();
 }
 
+int SpiDrv_sendCmd(uint8 cmd, uint8 numParam, tParam *params) {
+    // Released once the matching response has been read
+    if (!SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS))) {
+        return 0;
+    }
+
+    SpiDrv_sendFrame(txBuffer, SpiDrv_buildCmd(txBuffer, cmd, numParam, params));
+    return 1;
+}
+
+/*
+ * The NINA firmware works on one command at a time, so the best we can do is keep the bus for the whole
+ * batch.  No other task gets onto the bus and nothing yields between commands other than the ready
+ * handshakes themselves.  Each frame is built in txBuffer once the previous reply is in; sending is
+ * synchronous, so there is nothing to overlap the build with.
+ */
+int SpiDrv_runCommands(SpiDrvCmd_t *cmds, uint8 count) {
+    int succeeded = 0;
+
+    if (count == 0 || !SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS))) {
+        return 0;
+    }
+
+    for (int i = 0; i < count; i++) {
+        SpiDrvCmd_t *cmd = &cmds[i];
+
+        // Taken again for each command, the response gives it back
+        SpiDrv_lockBus(portMAX_DELAY);
+        SpiDrv_sendFrame(txBuffer, SpiDrv_buildCmd(txBuffer, cmd->cmd, cmd->numParam, cmd->params));
+
+        cmd->result = SpiDrv_receiveResponseCmd(cmd->cmd, cmd->maxReplySize, &cmd->paramsRead, cmd->replyParams,
+                                                cmd->maxReplyParams);
+        if (cmd->result) {
+            succeeded++;
+        }
+    }
+
+    SpiDrv_unlockBus();
+    return succeeded;
+}
+
 int SpiDrv_receiveResponseCmd(uint8 cmd, uint16 maxSize, uint8 *numParamRead, tParam *params, uint8 maxNumParams) {
-    uint8 _data = 0;
+    tDataParam dataParams[maxNumParams ? maxNumParams : 1];
+    int result;
+
+    for (int i = 0; i < maxNumParams; i++) {
+        dataParams[i].dataLen = params[i].paramLen;
+        dataParams[i].data = params[i].param;
+    }
+
+    result = SpiDrv_receiveResponse(cmd, maxSize, 1, numParamRead, dataParams, maxNumParams);
+
+    for (int i = 0; i < *numParamRead; i++) {
+        params[i].paramLen = dataParams[i].dataLen;
+    }
+    return result;
+}
+
+static int SpiDrv_receiveResponse(uint8 cmd, uint16 maxSize, uint8 lenSize, uint8 *numParamRead, tDataParam *params,
+                                  uint8 maxNumParams) {
+    int result;
 
-    if (maxSize > SPI_MAX_RX_BUFFER) {
-        maxSize = SPI_MAX_RX_BUFFER;
+    *numParamRead = 0;
+
+    // The command never went out if we could not get the bus
+    if (!SpiDrv_ownsBus()) {
+        return 0;
     }
 
     // Make sure the TX and RX buffer are cleared
@@ -284,48 +575,121 @@ int SpiDrv_receiveResponseCmd(uint8 cmd, uint16 maxSize, uint8 *numParamRead, tP
 
     // Wait the reply elaboration
     SpiDrv_waitForSlaveSelect();
-
-    // Unfortunately, to receive, we must transmit.  Transmit all zeros.
-    memset(txBuffer, 0, maxSize);
-    SPIM_WIFI_PutArray(txBuffer, maxSize);
-    xSemaphoreTake(spiTxCompleted, portMAX_DELAY);
+    result = SpiDrv_readResponse(cmd, maxSize, lenSize, numParamRead, params, maxNumParams);
     SpiDrv_spiSlaveDeselect();
 
-    // The data will come into the rx buffer as we Tx, so let's pull from it.
-    if (!SpiDrv_waitSpiChar(START_CMD)) {
-        return 0;
-    }
+    SPI_DRV_STATS_REPLY(cmd, result);
 
-    if (!SpiDrv_readAndCheckChar(cmd | REPLY_FLAG, &_data)) {
-        return 0;
+    SpiDrv_unlockBus();
+
+    return result;
+}
+
+/*
+ * Read a reply frame, clocking only as many bytes as the frame itself declares.  The header and the first
+ * parameter length are read in one go, then each parameter's data is read straight into the caller's buffer.
+ * Any data that does not fit is clocked in and discarded so we stay in step with the frame.  maxSize bounds
+ * the total number of bytes we are willing to clock for a single reply.
+ */
+static int SpiDrv_readResponse(uint8 cmd, uint16 maxSize, uint8 lenSize, uint8 *numParamRead, tDataParam *params,
+                               uint8 maxNumParams) {
+    uint8 header[5];
+    uint8 small[SPI_SMALL_PARAM_SIZE + 2];
+    uint8 headerLen = 3 + lenSize;
+    uint16 total = headerLen;
+    uint8 numParam;
+    uint8 *trailer = small;
+    uint16 len;
+    int i;
+
+    SpiDrv_transfer(NULL, header, headerLen);
+
+    // Normally the reply starts right away, but be tolerant of some leading garbage
+    for (i = 0; i < headerLen && header[i] != START_CMD; i++) {
+        if (header[i] == ERR_CMD) {
+            SPI_DRV_STATS_ADD(errCmd, 1);
+            return 0;
+        }
     }
 
-    uint8 numParam = SpiDrv_readChar();
+    if (i == headerLen) {
+        int found = SpiDrv_waitSpiChar(START_CMD);
+        if (found != 1) {
+            if (found < 0) {
+                SPI_DRV_STATS_ADD(errCmd, 1);
+            } else {
+                SPI_DRV_STATS_ADD(badStart, 1);
+            }
+            return 0;
+        }
+        header[0] = START_CMD;
+        SpiDrv_transfer(NULL, &header[1], headerLen - 1);
+    } else if (i > 0) {
+        memmove(header, &header[i], headerLen - i);
+        SpiDrv_transfer(NULL, &header[headerLen - i], i);
+    }
 
-    if (numParam > maxNumParams) {
-        numParam = maxNumParams;
+    if (header[1] != (cmd | REPLY_FLAG)) {
+        SPI_DRV_STATS_ADD(badCmd, 1);
+        return 0;
     }
 
-    *numParamRead = numParam;
+    numParam = header[2];
     if (numParam == 0) {
+        SPI_DRV_STATS_ADD(badLength, 1);
         return 0;
     }
 
-    for (int i = 0; i < numParam; ++i) {
-        tParam *param = &params[i];
-        uint8 *buf = param->param;
-        uint8 len = SpiDrv_readChar();
+    len = (lenSize == 2) ? ((header[3] << 8) | header[4]) : header[3];
+
+    for (i = 0; i < numParam; i++) {
+        // What follows this parameter: the next length, or the END_CMD
+        uint8 trailerLen = (i + 1 < numParam) ? lenSize : 1;
+        uint8 *buf = NULL;
+        uint16 bufLen = 0;
+        uint16 copyLen;
 
-        if (len >= param->paramLen) {
-            len = param->paramLen - 1;
+        total += len + trailerLen;
+        if (total > maxSize) {
+            SPI_DRV_STATS_ADD(badLength, 1);
+            return 0;
         }
 
-        for (int j = 0; j < len; j++) {
-            *buf++ = SpiDrv_readChar();
+        if (i < maxNumParams) {
+            buf = params[i].data;
+            bufLen = params[i].dataLen;
+        }
+        copyLen = (len > bufLen) ? bufLen : len;
+
+        if (len <= SPI_SMALL_PARAM_SIZE) {
+            SpiDrv_transfer(NULL, small, len + trailerLen);
+            if (copyLen) {
+                memcpy(buf, small, copyLen);
+            }
+            trailer = &small[len];
+        } else {
+            SpiDrv_transfer(NULL, buf, copyLen);
+            SpiDrv_transfer(NULL, NULL, len - copyLen);
+            SpiDrv_transfer(NULL, small, trailerLen);
+            trailer = small;
+        }
+
+        if (buf) {
+            if (copyLen < bufLen) {
+                buf[copyLen] = 0;
+            }
+            params[i].dataLen = copyLen;
+        }
+
+        if (i + 1 < numParam) {
+            len = (lenSize == 2) ? ((trailer[0] << 8) | trailer[1]) : trailer[0];
         }
-        *buf = 0;
-        param->paramLen = len;
     }
 
-    return SpiDrv_readAndCheckChar(END_CMD, &_data);
+    *numParamRead = (numParam > maxNumParams) ? maxNumParams : numParam;
+    if (trailer[0] != END_CMD) {
+        SPI_DRV_STATS_ADD(badEnd, 1);
+        return 0;
+    }
+    return 1;
 }
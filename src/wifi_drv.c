@@ -25,11 +25,13 @@
 #include "wifi_spi.h"
 #include "wl_types.h"
 
+#include <string.h>
+
 // Array of data to cache the information related to the networks discovered
-uint8 WiFiDrv__networkSsid[WL_NETWORKS_LIST_MAXNUM][WL_SSID_MAX_LENGTH];
+uint8 WiFiDrv__networkSsid[WL_NETWORKS_LIST_MAXNUM][WL_SSID_MAX_LENGTH + 1];
 
 // Cached values of retrieved data
-uint8 WiFiDrv__ssid[WL_SSID_MAX_LENGTH] = {0};
+uint8 WiFiDrv__ssid[WL_SSID_MAX_LENGTH + 1] = {0};
 uint8 WiFiDrv__bssid[WL_MAC_ADDR_LENGTH] = {0};
 uint8 WiFiDrv__mac[WL_MAC_ADDR_LENGTH] = {0};
 uint32 WiFiDrv__localIp = 0;
@@ -37,7 +39,7 @@ uint32 WiFiDrv__subnetMask = 0;
 uint32 WiFiDrv__gatewayIp = 0;
 
 // Firmware version
-uint8 WiFiDrv_fwVersion[WL_FW_VER_LENGTH] = {0};
+uint8 WiFiDrv_fwVersion[WL_FW_VER_LENGTH + 1] = {0};
 
 
 /*
@@ -45,10 +47,6 @@ uint8 WiFiDrv_fwVersion[WL_FW_VER_LENGTH] = {0};
  */
 static int WiFiDrv_getNetworkData(uint32 *ip, uint32 *mask, uint32 *gwip);
 
-static int WiFiDrv_reqHostByName(uint8 *aHostname);
-
-static int WiFiDrv_getHostByNameResults(uint32 *aResult);
-
 
 // Private Methods
 static int WiFiDrv_getNetworkData(uint32 *ip, uint32 *mask, uint32 *gwip) {
@@ -206,7 +204,9 @@ int WiFiDrv_disconnect(void) {
     SpiDrv_sendCmd(DISCONNECT_CMD, 1, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(DISCONNECT_CMD, 16, &paramsRead, outParams, 1);
+    if (!SpiDrv_receiveResponseCmd(DISCONNECT_CMD, 16, &paramsRead, outParams, 1)) {
+        return WL_FAILURE;
+    }
     return _data;
 }
 
@@ -220,7 +220,9 @@ int WiFiDrv_getConnectionStatus(void) {
     SpiDrv_sendCmd(GET_CONN_STATUS_CMD, 0, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(GET_CONN_STATUS_CMD, 16, &paramsRead, outParams, 1);
+    if (!SpiDrv_receiveResponseCmd(GET_CONN_STATUS_CMD, 16, &paramsRead, outParams, 1)) {
+        return WL_FAILURE;
+    }
     return _data;
 }
 
@@ -265,7 +267,7 @@ uint8 *WiFiDrv_getCurrentSSID(void) {
     // Send Command
     SpiDrv_sendCmd(GET_CURR_SSID_CMD, 1, inParams);
 
-    memset(WiFiDrv__ssid, 0x00, WL_SSID_MAX_LENGTH);
+    memset(WiFiDrv__ssid, 0x00, sizeof(WiFiDrv__ssid));
 
     // Wait for reply
     SpiDrv_receiveResponseCmd(GET_CURR_SSID_CMD, 48, &paramsRead, outParams, 1);
@@ -288,7 +290,7 @@ uint8 *WiFiDrv_getCurrentBSSID(void) {
 
 int32 WiFiDrv_getCurrentRSSI(void) {
     uint8 _dummy = DUMMY_DATA;
-    int32 rssi;
+    int32 rssi = 0;
     tParam inParams[] = {{1, &_dummy}};
     tParam outParams[] = {{4, &rssi}};
     uint8 paramsRead;
@@ -316,6 +318,41 @@ int WiFiDrv_getCurrentEncryptionType(void) {
     return encType;
 }
 
+int WiFiDrv_getLinkInfo(WiFiDrvLinkInfo_t *info) {
+    uint8 _dummy = DUMMY_DATA;
+    tParam dummyParams[] = {{1, &_dummy}};
+    tParam statusParams[] = {{1, &info->status}};
+    tParam networkParams[] = {{4, &info->localIp},
+                              {4, &info->subnetMask},
+                              {4, &info->gatewayIp}};
+    tParam ssidParams[] = {{WL_SSID_MAX_LENGTH, info->ssid}};
+    tParam bssidParams[] = {{WL_MAC_ADDR_LENGTH, info->bssid}};
+    tParam rssiParams[] = {{4, &info->rssi}};
+    tParam encParams[] = {{1, &info->encryptionType}};
+    SpiDrvCmd_t cmds[] = {
+            {GET_CONN_STATUS_CMD, 0, NULL,        16, 1, statusParams,  0, 0},
+            {GET_IPADDR_CMD,      1, dummyParams, 24, 3, networkParams, 0, 0},
+            {GET_CURR_SSID_CMD,   1, dummyParams, 48, 1, ssidParams,    0, 0},
+            {GET_CURR_BSSID_CMD,  1, dummyParams, 32, 1, bssidParams,   0, 0},
+            {GET_CURR_RSSI_CMD,   1, dummyParams, 20, 1, rssiParams,    0, 0},
+            {GET_CURR_ENCT_CMD,   1, dummyParams, 20, 1, encParams,     0, 0},
+    };
+    int count = sizeof(cmds) / sizeof(cmds[0]);
+    int answered = 0;
+
+    memset(info->ssid, 0x00, sizeof(info->ssid));
+
+    SpiDrv_runCommands(cmds, count);
+
+    // One bit per command, in the order of the WIFI_DRV_LINK_* bits
+    for (int i = 0; i < count; i++) {
+        if (cmds[i].result) {
+            answered |= 1 << i;
+        }
+    }
+    return answered;
+}
+
 int WiFiDrv_startScanNetworks(void) {
     int8 _data = 0;
     tParam inParams[] = {};
@@ -353,7 +390,10 @@ int WiFiDrv_getScanNetworks(void) {
     }
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(SCAN_NETWORKS, WIFI_SOCKET_BUFFER_SIZE, &paramsRead, outParams, WL_NETWORKS_LIST_MAXNUM);
+    if (!SpiDrv_receiveResponseCmd(SCAN_NETWORKS, WL_NETWORKS_LIST_MAXNUM * (WL_SSID_MAX_LENGTH + 1) + 4,
+                                   &paramsRead, outParams, WL_NETWORKS_LIST_MAXNUM)) {
+        return 0;
+    }
     return paramsRead;
 }
 
@@ -427,11 +467,69 @@ int32 WiFiDrv_getRSSINetworks(uint8 networkItem) {
     SpiDrv_sendCmd(GET_IDX_RSSI_CMD, 1, inParams);
 
     // Wait for reply
-    SpiDrv_receiveResponseCmd(GET_IDX_CHANNEL_CMD, 20, &paramsRead, outParams, 1);
+    SpiDrv_receiveResponseCmd(GET_IDX_RSSI_CMD, 20, &paramsRead, outParams, 1);
     return rssi;
 }
 
-static int WiFiDrv_reqHostByName(uint8 *aHostname) {
+int WiFiDrv_getNetworks(WiFiDrvNetwork_t *networks, uint8 count) {
+    uint8 index[WIFI_DRV_NETWORKS_PER_BATCH];
+    tParam inParams[WIFI_DRV_NETWORKS_PER_BATCH][1];
+    tParam outParams[WIFI_DRV_NETWORKS_PER_BATCH][4];
+    SpiDrvCmd_t cmds[WIFI_DRV_NETWORKS_PER_BATCH * 4];
+    int filled = 0;
+
+    if (count > WL_NETWORKS_LIST_MAXNUM) {
+        count = WL_NETWORKS_LIST_MAXNUM;
+    }
+
+    // Keep the bus between batches so nobody else's scan can replace the list underneath us
+    if (!SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS))) {
+        return 0;
+    }
+
+    for (uint8 first = 0; first < count; first += WIFI_DRV_NETWORKS_PER_BATCH) {
+        uint8 batch = (count - first > WIFI_DRV_NETWORKS_PER_BATCH) ? WIFI_DRV_NETWORKS_PER_BATCH : count - first;
+
+        for (uint8 i = 0; i < batch; i++) {
+            WiFiDrvNetwork_t *network = &networks[first + i];
+
+            memset(network, 0x00, sizeof(WiFiDrvNetwork_t));
+            memcpy(network->ssid, WiFiDrv__networkSsid[first + i], WL_SSID_MAX_LENGTH);
+
+            index[i] = first + i;
+            inParams[i][0] = (tParam) {1, &index[i]};
+            outParams[i][0] = (tParam) {4, &network->rssi};
+            outParams[i][1] = (tParam) {1, &network->encryptionType};
+            outParams[i][2] = (tParam) {WL_MAC_ADDR_LENGTH, network->bssid};
+            outParams[i][3] = (tParam) {1, &network->channel};
+
+            cmds[4 * i + 0] = (SpiDrvCmd_t) {GET_IDX_RSSI_CMD,    1, inParams[i], 20, 1, &outParams[i][0], 0, 0};
+            cmds[4 * i + 1] = (SpiDrvCmd_t) {GET_IDX_ENCT_CMD,    1, inParams[i], 20, 1, &outParams[i][1], 0, 0};
+            cmds[4 * i + 2] = (SpiDrvCmd_t) {GET_IDX_BSSID,       1, inParams[i], 32, 1, &outParams[i][2], 0, 0};
+            cmds[4 * i + 3] = (SpiDrvCmd_t) {GET_IDX_CHANNEL_CMD, 1, inParams[i], 20, 1, &outParams[i][3], 0, 0};
+        }
+
+        // Nothing came back at all, the rest won't fare any better
+        if (!SpiDrv_runCommands(cmds, 4 * batch)) {
+            break;
+        }
+
+        // Close up behind any network we didn't get in full so the good ones are all at the front
+        for (uint8 i = 0; i < batch; i++) {
+            if (cmds[4 * i].result && cmds[4 * i + 1].result && cmds[4 * i + 2].result && cmds[4 * i + 3].result) {
+                if (filled != first + i) {
+                    networks[filled] = networks[first + i];
+                }
+                filled++;
+            }
+        }
+    }
+
+    SpiDrv_unlockBus();
+    return filled;
+}
+
+int WiFiDrv_reqHostByName(uint8 *aHostname) {
     uint8 _data = 0;
     uint8 result;
     tParam inParams[] = {{ustrlen(aHostname), aHostname}};
@@ -444,14 +542,14 @@ static int WiFiDrv_reqHostByName(uint8 *aHostname) {
     // Wait for reply
     result = SpiDrv_receiveResponseCmd(REQ_HOST_BY_NAME_CMD, 20, &paramsRead, outParams, 1);
 
-    if (result) {
-        result = (_data == 1);
+    // -1 if the co-processor never answered, 0 if it answered that the lookup failed
+    if (!result) {
+        return -1;
     }
-
-    return result;
+    return (_data == 1);
 }
 
-static int WiFiDrv_getHostByNameResults(uint32 *aResult) {
+int WiFiDrv_getHostByNameResults(uint32 *aResult) {
     uint32 _ipAddr;
     uint32 dummy = 0xFFFFFFFF;
     int result = 0;
@@ -464,19 +562,36 @@ static int WiFiDrv_getHostByNameResults(uint32 *aResult) {
 
     // Wait for reply
     result = SpiDrv_receiveResponseCmd(GET_HOST_BY_NAME_CMD, 32, &paramsRead, outParams, 1);
-    if (result) {
-        *aResult = _ipAddr;
-        result = (_ipAddr != dummy);
+
+    // Same as the request: -1 if the co-processor never answered, aResult is left alone then
+    if (!result) {
+        return -1;
     }
-    return result;
+    *aResult = _ipAddr;
+    return (_ipAddr != dummy);
 }
 
 int WiFiDrv_getHostByName(uint8 *aHostname, uint32 *aResult) {
-    if (WiFiDrv_reqHostByName(aHostname)) {
-        return WiFiDrv_getHostByNameResults(aResult);
-    } else {
+    int result;
+
+    // Nobody else's request may get in between ours and its result
+    if (!SpiDrv_lockBus(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS))) {
         return 0;
     }
+
+    result = WiFiDrv_reqHostByName(aHostname);
+    if (result == 1) {
+        result = WiFiDrv_getHostByNameResults(aResult);
+        SpiDrv_unlockBus();
+        return (result == 1);
+    }
+    SpiDrv_unlockBus();
+
+    // Report a failed lookup the way GET_HOST_BY_NAME_CMD would
+    if (result == 0) {
+        *aResult = 0xFFFFFFFF;
+    }
+    return 0;
 }
 
 uint8 *WiFiDrv_getFwVersion(void) {
@@ -487,6 +602,8 @@ uint8 *WiFiDrv_getFwVersion(void) {
     // Send Command
     SpiDrv_sendCmd(GET_FW_VERSION_CMD, 0, inParams);
 
+    memset(WiFiDrv_fwVersion, 0x00, sizeof(WiFiDrv_fwVersion));
+
     // Wait for reply
     SpiDrv_receiveResponseCmd(GET_FW_VERSION_CMD, 48, &paramsRead, outParams, 1);
     return WiFiDrv_fwVersion;
@@ -0,0 +1,238 @@
+/*
+  bench_spi.c - Cost of SPI command round-trips against the fake NINA
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "server_drv.h"
+#include "spi_drv.h"
+#include "wifi_drv.h"
+#include "wl_definitions.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Runs representative transactions one at a time and reports, per transaction, what went over
+ * the bus according to the fake NINA: bytes clocked, how many of them carried nothing either way
+ * (dummy bytes), slave selects (each one a ready handshake) and SPIM transfers.  Wall time is the
+ * host's time through the driver and the fake, so it only means something relative to other runs
+ * on the same machine.
+ *
+ * A reply is read by its own lengths, so a transaction that clocks any dummy bytes is a regression
+ * (e.g. reading maxSize instead of the reply) and fails the run.
+ */
+
+#define BENCH_DEFAULT_ITERATIONS 200
+
+typedef struct _BenchCase {
+    const char *name;
+    uint16 payload;
+    void (*setup)(uint16 payload);
+    int (*run)(uint16 payload);
+} BenchCase_t;
+
+typedef struct _BenchResult {
+    uint32 failures;
+    uint32 gateFailures;
+    uint64_t clocked;
+    uint64_t frameBytes;
+    uint64_t replyBytes;
+    uint64_t dummyBytes;
+    uint64_t selects;
+    uint64_t transfers;
+    uint64_t ns;
+} BenchResult_t;
+
+static uint8 Bench_data[WIFI_SOCKET_BUFFER_SIZE];
+static uint8 Bench_rx[WIFI_SOCKET_BUFFER_SIZE];
+
+static void Bench_setupNone(uint16 payload) {
+}
+
+static int Bench_connStatus(uint16 payload) {
+    return WiFiDrv_getConnectionStatus() == WL_CONNECTED;
+}
+
+static void Bench_setupDataBuf(uint16 payload) {
+    FakeNina_setRx(0, ESTABLISHED, Bench_data, payload);
+}
+
+// Always asks for a full buffer, whatever is waiting
+static int Bench_dataBuf(uint16 payload) {
+    uint16 len = sizeof(Bench_rx);
+
+    return ServerDrv_getDataBuf(0, Bench_rx, &len) == payload && len == payload;
+}
+
+static void Bench_setupSendData(uint16 payload) {
+    FakeNina_setRx(0, ESTABLISHED, NULL, 0);
+    FakeNina_socket(0)->txLength = 0;
+}
+
+static int Bench_sendData(uint16 payload) {
+    return ServerDrv_sendData(0, Bench_data, payload) == payload;
+}
+
+static void Bench_setupScan(uint16 payload) {
+    FakeNina_setNetworks(payload);
+}
+
+static int Bench_scan(uint16 payload) {
+    return WiFiDrv_getScanNetworks() == payload;
+}
+
+static const BenchCase_t Bench_cases[] = {
+    {"GET_CONN_STATUS_CMD", 1, Bench_setupNone, Bench_connStatus},
+    {"GET_DATABUF_TCP_CMD", 1, Bench_setupDataBuf, Bench_dataBuf},
+    {"GET_DATABUF_TCP_CMD", 16, Bench_setupDataBuf, Bench_dataBuf},
+    {"GET_DATABUF_TCP_CMD", 64, Bench_setupDataBuf, Bench_dataBuf},
+    {"GET_DATABUF_TCP_CMD", 255, Bench_setupDataBuf, Bench_dataBuf},
+    {"GET_DATABUF_TCP_CMD", 256, Bench_setupDataBuf, Bench_dataBuf},
+    {"GET_DATABUF_TCP_CMD", 512, Bench_setupDataBuf, Bench_dataBuf},
+    {"GET_DATABUF_TCP_CMD", 1024, Bench_setupDataBuf, Bench_dataBuf},
+    {"GET_DATABUF_TCP_CMD", WIFI_SOCKET_BUFFER_SIZE, Bench_setupDataBuf, Bench_dataBuf},
+    {"SEND_DATA_TCP_CMD", 1, Bench_setupSendData, Bench_sendData},
+    {"SEND_DATA_TCP_CMD", 16, Bench_setupSendData, Bench_sendData},
+    {"SEND_DATA_TCP_CMD", 64, Bench_setupSendData, Bench_sendData},
+    {"SEND_DATA_TCP_CMD", 255, Bench_setupSendData, Bench_sendData},
+    {"SEND_DATA_TCP_CMD", 256, Bench_setupSendData, Bench_sendData},
+    {"SEND_DATA_TCP_CMD", 512, Bench_setupSendData, Bench_sendData},
+    {"SEND_DATA_TCP_CMD", 1024, Bench_setupSendData, Bench_sendData},
+    {"SEND_DATA_TCP_CMD", WIFI_SOCKET_BUFFER_SIZE, Bench_setupSendData, Bench_sendData},
+    {"SCAN_NETWORKS", 1, Bench_setupScan, Bench_scan},
+    {"SCAN_NETWORKS", 5, Bench_setupScan, Bench_scan},
+    {"SCAN_NETWORKS", WL_NETWORKS_LIST_MAXNUM, Bench_setupScan, Bench_scan},
+};
+
+#define BENCH_NUM_CASES (sizeof(Bench_cases) / sizeof(Bench_cases[0]))
+
+static uint64_t Bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void Bench_run(const BenchCase_t *bench, int iterations, BenchResult_t *result) {
+    memset(result, 0x00, sizeof(*result));
+    Test_setup();
+    FakeNina_setStatus(WL_CONNECTED);
+
+    for (int i = 0; i < iterations; i++) {
+        FakeNinaStats_t stats;
+
+        bench->setup(bench->payload);
+        FakeNina_resetStats();
+
+        uint64_t start = Bench_now();
+        int ok = bench->run(bench->payload);
+        result->ns += Bench_now() - start;
+
+        FakeNina_getStats(&stats);
+        if (!ok) {
+            result->failures++;
+        }
+        if (stats.idleBytes || stats.unselectedBytes || stats.badFrames) {
+            result->gateFailures++;
+        }
+
+        result->clocked += stats.frameBytes + stats.replyBytes + stats.idleBytes + stats.unselectedBytes;
+        result->frameBytes += stats.frameBytes;
+        result->replyBytes += stats.replyBytes;
+        result->dummyBytes += stats.idleBytes + stats.unselectedBytes;
+        result->selects += stats.selects;
+        result->transfers += stats.transfers;
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int iterations = BENCH_DEFAULT_ITERATIONS;
+    const char *output = NULL;
+    int failed = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+        switch (opt) {
+            case 'n':
+                iterations = atoi(optarg);
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-o report.csv]\n", argv[0]);
+                return 2;
+        }
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    FILE *report = output ? fopen(output, "w") : NULL;
+    if (output && !report) {
+        perror(output);
+        return 2;
+    }
+
+    for (uint16 i = 0; i < sizeof(Bench_data); i++) {
+        Bench_data[i] = i * 31 + (i >> 8);
+    }
+
+    const char *header = "command,payload,iterations,failures,bytes_clocked,frame_bytes,reply_bytes,dummy_bytes,"
+                         "handshakes,transfers,ns\n";
+    printf("%s", header);
+    if (report) {
+        fprintf(report, "%s", header);
+    }
+
+    // Per transaction averages, the gate is on every single one
+    for (unsigned int n = 0; n < BENCH_NUM_CASES; n++) {
+        const BenchCase_t *bench = &Bench_cases[n];
+        BenchResult_t result;
+        char line[256];
+
+        Bench_run(bench, iterations, &result);
+        snprintf(line, sizeof(line), "%s,%u,%d,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.0f\n", bench->name,
+                 bench->payload, iterations, result.failures, (double) result.clocked / iterations,
+                 (double) result.frameBytes / iterations, (double) result.replyBytes / iterations,
+                 (double) result.dummyBytes / iterations, (double) result.selects / iterations,
+                 (double) result.transfers / iterations, (double) result.ns / iterations);
+        printf("%s", line);
+        if (report) {
+            fprintf(report, "%s", line);
+        }
+
+        if (result.failures) {
+            fprintf(stderr, "%s %u: %u of %d transactions failed\n", bench->name, bench->payload, result.failures,
+                    iterations);
+            failed = 1;
+        }
+        if (result.gateFailures) {
+            fprintf(stderr, "%s %u: %u of %d transactions clocked %.1f dummy bytes on average\n", bench->name,
+                    bench->payload, result.gateFailures, iterations, (double) result.dummyBytes / iterations);
+            failed = 1;
+        }
+    }
+
+    if (report) {
+        fclose(report);
+    }
+    return failed;
+}
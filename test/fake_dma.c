@@ -0,0 +1,266 @@
+/*
+  fake_dma.c - DMA controller stand-in for the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "project.h"
+#include "fake_dma.h"
+#include "fake_nina.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Addresses handed out for host pointers, a slot each.  Slots are reused round robin.
+#define FAKE_DMA_SLOTS 32
+#define FAKE_DMA_SLOT_SIZE 0x40
+#define FAKE_DMA_FLASH_SLOTS (CYDEV_FLASH_BASE + 0x1000)
+
+// Where the SPIM FIFOs sit on the peripheral bus
+#define FAKE_DMA_SPIM_TXDATA (CYDEV_PERIPH_BASE + 0x6400)
+#define FAKE_DMA_SPIM_RXDATA (CYDEV_PERIPH_BASE + 0x6410)
+
+#define FAKE_DMA_TX_CHANNEL 0
+#define FAKE_DMA_RX_CHANNEL 1
+#define FAKE_DMA_NUM_TDS 8
+#define FAKE_DMA_MAX_COUNT 1024
+
+typedef struct _FakeDmaTd {
+    uint16 count;
+    uint8 next;
+    uint8 config;
+    uint16 src;
+    uint16 dst;
+} FakeDmaTd_t;
+
+typedef struct _FakeDmaChannel {
+    uint16 upperSrc;
+    uint16 upperDst;
+    uint8 td;
+    uint8 enabled;
+} FakeDmaChannel_t;
+
+reg8 FakeSpim_txData;
+reg8 FakeSpim_rxData;
+
+static const volatile void *FakeDma_sram[FAKE_DMA_SLOTS];
+static const volatile void *FakeDma_flash[FAKE_DMA_SLOTS];
+static uint8 FakeDma_nextSram = 0;
+static uint8 FakeDma_nextFlash = 0;
+
+static FakeDmaTd_t FakeDma_tds[FAKE_DMA_NUM_TDS];
+static uint8 FakeDma_numTds = 0;
+static FakeDmaChannel_t FakeDma_channels[2];
+static cyisraddress FakeDma_rxIsr = NULL;
+static FakeDmaStats_t FakeDma_stats;
+
+// From the linker: constants sit between the start of the program and its writable data, as they would in flash
+extern const char __executable_start[];
+extern const char __data_start[];
+
+static void FakeDma_fault(const char *why) {
+    FakeDma_stats.faults++;
+    printf("fake_dma: %s\n", why);
+}
+
+static uint8 FakeDma_slot(const volatile void **slots, uint8 *next, const volatile void *ptr) {
+    for (uint8 i = 0; i < FAKE_DMA_SLOTS; i++) {
+        if (slots[i] == ptr) {
+            return i;
+        }
+    }
+
+    uint8 slot = *next;
+    *next = (slot + 1) % FAKE_DMA_SLOTS;
+    slots[slot] = ptr;
+    return slot;
+}
+
+uint32 FakeDma_address(const volatile void *ptr) {
+    const char *p = (const char *) ptr;
+
+    if (ptr == &FakeSpim_txData) {
+        return FAKE_DMA_SPIM_TXDATA;
+    }
+    if (ptr == &FakeSpim_rxData) {
+        return FAKE_DMA_SPIM_RXDATA;
+    }
+    if (p >= __executable_start && p < __data_start) {
+        return FAKE_DMA_FLASH_SLOTS + FakeDma_slot(FakeDma_flash, &FakeDma_nextFlash, ptr) * FAKE_DMA_SLOT_SIZE;
+    }
+    return CYDEV_SRAM_BASE + FakeDma_slot(FakeDma_sram, &FakeDma_nextSram, ptr) * FAKE_DMA_SLOT_SIZE;
+}
+
+// Back from a descriptor address to the SRAM it stands for, NULL if it isn't one we handed out
+static uint8 *FakeDma_sramPointer(uint16 upper, uint16 lower) {
+    uint32 address = ((uint32) upper << 16) | lower;
+    uint32 offset = address - CYDEV_SRAM_BASE;
+
+    if (address < CYDEV_SRAM_BASE || offset >= FAKE_DMA_SLOTS * FAKE_DMA_SLOT_SIZE ||
+        offset % FAKE_DMA_SLOT_SIZE) {
+        return NULL;
+    }
+    return (uint8 *) FakeDma_sram[offset / FAKE_DMA_SLOT_SIZE];
+}
+
+// The Tx channel was enabled: clock its descriptor out and the Rx descriptor in, then interrupt
+static void FakeDma_run(void) {
+    FakeDmaChannel_t *txChannel = &FakeDma_channels[FAKE_DMA_TX_CHANNEL];
+    FakeDmaChannel_t *rxChannel = &FakeDma_channels[FAKE_DMA_RX_CHANNEL];
+    FakeDmaTd_t *txTd = &FakeDma_tds[txChannel->td];
+    FakeDmaTd_t *rxTd = &FakeDma_tds[rxChannel->td];
+    uint8 out[FAKE_DMA_MAX_COUNT];
+    uint8 in[FAKE_DMA_MAX_COUNT];
+    uint16 count = txTd->count;
+
+    if (!rxChannel->enabled) {
+        // The first bytes back would have been lost
+        FakeDma_fault("Tx started before Rx was armed");
+    } else if (rxTd->count != count) {
+        FakeDma_fault("Tx and Rx descriptors are different lengths");
+    }
+    if (count == 0 || count > FAKE_DMA_MAX_COUNT) {
+        FakeDma_fault("bad Tx descriptor length");
+        count = count ? FAKE_DMA_MAX_COUNT : 0;
+    }
+
+    const uint8 *src = FakeDma_sramPointer(txChannel->upperSrc, txTd->src);
+    if (!src) {
+        // The Tx channel's upper address is SRAM, anywhere else reads whatever is at that offset in it
+        FakeDma_fault("Tx source is not in SRAM");
+        memset(out, 0xA5, count);
+    } else {
+        for (uint16 i = 0; i < count; i++) {
+            out[i] = (txTd->config & TD_INC_SRC_ADR) ? src[i] : src[0];
+        }
+    }
+    if (((uint32) txChannel->upperDst << 16 | txTd->dst) != FAKE_DMA_SPIM_TXDATA) {
+        FakeDma_fault("Tx destination is not SPIM_WIFI_TXDATA");
+    }
+
+    FakeNina_clock(out, in, count);
+
+    FakeDma_stats.chunks++;
+    FakeDma_stats.bytes += count;
+    if (count > FakeDma_stats.largestChunk) {
+        FakeDma_stats.largestChunk = count;
+    }
+    FakeDma_stats.lastTxSource = src;
+
+    if (rxChannel->enabled) {
+        uint8 *dst = FakeDma_sramPointer(rxChannel->upperDst, rxTd->dst);
+
+        if (((uint32) rxChannel->upperSrc << 16 | rxTd->src) != FAKE_DMA_SPIM_RXDATA) {
+            FakeDma_fault("Rx source is not SPIM_WIFI_RXDATA");
+        }
+        if (!dst) {
+            FakeDma_fault("Rx destination is not in SRAM");
+        } else if (rxTd->config & TD_INC_DST_ADR) {
+            memcpy(dst, in, count);
+        } else if (count) {
+            dst[0] = in[count - 1];
+        }
+    }
+
+    // Both descriptors chain to CY_DMA_DISABLE_TD, so the channels are done
+    txChannel->enabled = 0;
+    rxChannel->enabled = 0;
+
+    if (rxTd->config & DMA_WIFI_RX__TD_TERMOUT_EN) {
+        if (FakeDma_rxIsr) {
+            FakeDma_rxIsr();
+        } else {
+            FakeDma_fault("Rx done with no interrupt handler");
+        }
+    }
+}
+
+static uint8 FakeDma_initialize(uint8 channel, uint16 upperSrcAddress, uint16 upperDestAddress) {
+    FakeDma_channels[channel].upperSrc = upperSrcAddress;
+    FakeDma_channels[channel].upperDst = upperDestAddress;
+    FakeDma_channels[channel].enabled = 0;
+    return channel;
+}
+
+uint8 DMA_WIFI_TX_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress,
+                                uint16 upperDestAddress) {
+    return FakeDma_initialize(FAKE_DMA_TX_CHANNEL, upperSrcAddress, upperDestAddress);
+}
+
+uint8 DMA_WIFI_RX_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress,
+                                uint16 upperDestAddress) {
+    return FakeDma_initialize(FAKE_DMA_RX_CHANNEL, upperSrcAddress, upperDestAddress);
+}
+
+uint8 CyDmaTdAllocate(void) {
+    if (FakeDma_numTds >= FAKE_DMA_NUM_TDS) {
+        FakeDma_fault("out of descriptors");
+        return CY_DMA_DISABLE_TD;
+    }
+    return FakeDma_numTds++;
+}
+
+cystatus CyDmaTdSetConfiguration(uint8 tdHandle, uint16 transferCount, uint8 nextTd, uint8 configuration) {
+    if (tdHandle >= FakeDma_numTds) {
+        FakeDma_fault("configuring a descriptor that was never allocated");
+        return 1;
+    }
+    if (nextTd != CY_DMA_DISABLE_TD) {
+        FakeDma_fault("descriptor chains are not modelled");
+    }
+    FakeDma_tds[tdHandle].count = transferCount;
+    FakeDma_tds[tdHandle].next = nextTd;
+    FakeDma_tds[tdHandle].config = configuration;
+    return 0;
+}
+
+cystatus CyDmaTdSetAddress(uint8 tdHandle, uint16 source, uint16 destination) {
+    if (tdHandle >= FakeDma_numTds) {
+        FakeDma_fault("addressing a descriptor that was never allocated");
+        return 1;
+    }
+    FakeDma_tds[tdHandle].src = source;
+    FakeDma_tds[tdHandle].dst = destination;
+    return 0;
+}
+
+cystatus CyDmaChSetInitialTd(uint8 chHandle, uint8 startTd) {
+    if (FakeDma_channels[chHandle].enabled) {
+        FakeDma_fault("descriptor changed under an enabled channel");
+    }
+    FakeDma_channels[chHandle].td = startTd;
+    return 0;
+}
+
+cystatus CyDmaChEnable(uint8 chHandle, uint8 preserveTds) {
+    FakeDma_channels[chHandle].enabled = 1;
+    if (chHandle == FAKE_DMA_TX_CHANNEL) {
+        FakeDma_run();
+    }
+    return 0;
+}
+
+void isr_WIFI_DMA_RX_StartEx(cyisraddress address) {
+    FakeDma_rxIsr = address;
+}
+
+void FakeDma_resetStats(void) {
+    memset(&FakeDma_stats, 0x00, sizeof(FakeDma_stats));
+}
+
+void FakeDma_getStats(FakeDmaStats_t *stats) {
+    *stats = FakeDma_stats;
+}
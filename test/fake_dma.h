@@ -0,0 +1,46 @@
+/*
+  fake_dma.h - DMA_WIFI_TX, DMA_WIFI_RX and their descriptors for the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FakeDma_h
+#define FakeDma_h
+
+#include "project.h"
+
+/*
+ * Stands in for the two DMA channels and the Rx done interrupt that spi_dma.c drives.  Host
+ * pointers are handed out 32 bit addresses that stand for them, in SRAM for writable memory and in
+ * flash for the rest, so the driver's address checks see what they would on the chip.  Enabling
+ * the Tx channel runs the whole descriptor at once against the fake NINA and raises the Rx
+ * descriptor's interrupt.  Anything the real controller would have got wrong is a fault.
+ */
+
+typedef struct _FakeDmaStats {
+    uint32 chunks;              // descriptors run, one per enable of the Tx channel
+    uint32 bytes;
+    uint16 largestChunk;
+    uint32 faults;              // printed as they happen
+    const uint8 *lastTxSource;  // where the last chunk was read from, on the host
+} FakeDmaStats_t;
+
+// Clear the counters.  The channels and descriptors stay set up, as SpiDma_begin only runs once.
+void FakeDma_resetStats(void);
+
+void FakeDma_getStats(FakeDmaStats_t *stats);
+
+#endif
@@ -0,0 +1,694 @@
+/*
+  fake_nina.c - SPIM, pins and a scripted NINA co-processor for the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define _GNU_SOURCE
+
+#include "project.h"
+#include "fake_nina.h"
+#include "wifi_spi.h"
+#include "wl_definitions.h"
+#include "wl_types.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FAKE_NINA_MAX_REPLY 4096
+
+// Size of the SPIM software Rx buffer the driver reads back from
+#define FAKE_SPIM_RX_SIZE 1024
+
+typedef enum {
+    FAKE_NINA_WAIT_START,       // looking for START_CMD
+    FAKE_NINA_CMD,
+    FAKE_NINA_NUM_PARAM,
+    FAKE_NINA_PARAM_LEN,
+    FAKE_NINA_PARAM,
+    FAKE_NINA_END,              // padding, then END_CMD
+    FAKE_NINA_REPLY_PENDING,    // frame done, reply readable after the next deselect
+    FAKE_NINA_REPLY_READY,      // waiting for the host to select us and read it
+    FAKE_NINA_REPLY,
+} FakeNinaState_t;
+
+volatile uint8 FakeSpim_status = 0;
+
+// Tests poke at the model from their own task while others use the bus
+static pthread_mutex_t FakeNina_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static uint8 FakeNina_preempt = 0;
+static pthread_t FakeNina_selectedBy;
+
+static uint8 FakeSpim_rx[FAKE_SPIM_RX_SIZE];
+static uint16 FakeSpim_rxHead = 0;
+static uint16 FakeSpim_rxCount = 0;
+
+static FakeNinaState_t FakeNina_state = FAKE_NINA_WAIT_START;
+static uint8 FakeNina_selected = 0;
+static uint8 FakeNina_resetPin = 1;
+
+static FakeNinaFrame_t FakeNina_frame;
+static uint8 FakeNina_param;
+static uint16 FakeNina_paramPos;
+static uint8 FakeNina_lenPos;
+
+static uint8 FakeNina_reply[FAKE_NINA_MAX_REPLY];
+static uint16 FakeNina_replyLength;
+static uint16 FakeNina_replyPos;
+static uint8 FakeNina_replyLenSize;
+
+static FakeNinaStats_t FakeNina_stats;
+static FakeNinaSocket_t FakeNina_sockets[FAKE_NINA_NUM_SOCKETS];
+static uint8 FakeNina_status = WL_IDLE_STATUS;
+static uint8 FakeNina_networks = 0;
+
+static uint8 FakeNina_failOpcode;
+static int FakeNina_failSock;
+static int FakeNina_failCount = 0;
+
+static uint8 FakeNina_raw[FAKE_NINA_MAX_REPLY];
+static uint16 FakeNina_rawLength = 0;
+
+
+static uint8 FakeNina_lenSize(uint8 cmd) {
+    return (cmd & DATA_FLAG) ? 2 : 1;
+}
+
+static void FakeNina_replyBegin(uint8 numParam) {
+    // Only the data buffer reply uses 16 bit lengths, everything else is an ordinary command reply
+    FakeNina_replyLenSize = (FakeNina_frame.cmd == GET_DATABUF_TCP_CMD) ? 2 : 1;
+    FakeNina_replyLength = 0;
+    FakeNina_reply[FakeNina_replyLength++] = START_CMD;
+    FakeNina_reply[FakeNina_replyLength++] = FakeNina_frame.cmd | REPLY_FLAG;
+    FakeNina_reply[FakeNina_replyLength++] = numParam;
+}
+
+static void FakeNina_replyParam(const void *data, uint16 length) {
+    if (FakeNina_replyLenSize == 2) {
+        FakeNina_reply[FakeNina_replyLength++] = length >> 8;
+    }
+    FakeNina_reply[FakeNina_replyLength++] = length & 0xFF;
+    memcpy(&FakeNina_reply[FakeNina_replyLength], data, length);
+    FakeNina_replyLength += length;
+}
+
+static void FakeNina_replyByte(uint8 value) {
+    FakeNina_replyParam(&value, 1);
+}
+
+static void FakeNina_replyEnd(void) {
+    FakeNina_reply[FakeNina_replyLength++] = END_CMD;
+}
+
+static void FakeNina_replyError(void) {
+    FakeNina_replyLength = 0;
+    FakeNina_reply[FakeNina_replyLength++] = ERR_CMD;
+}
+
+static FakeNinaSocket_t *FakeNina_frameSocket(void) {
+    if (FakeNina_frame.numParam < 1 || FakeNina_frame.param[0][0] >= FAKE_NINA_NUM_SOCKETS) {
+        return NULL;
+    }
+    return &FakeNina_sockets[FakeNina_frame.param[0][0]];
+}
+
+// The little bit of the firmware the library needs
+static void FakeNina_model(void) {
+    const FakeNinaFrame_t *f = &FakeNina_frame;
+    FakeNinaSocket_t *socket = FakeNina_frameSocket();
+    uint8 buf[WL_SSID_MAX_LENGTH + 1];
+    uint32 value;
+
+    switch (f->cmd) {
+        case GET_CONN_STATUS_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(FakeNina_status);
+            break;
+
+        case GET_IPADDR_CMD: {
+            uint32 addr[3] = {0x0A00A8C0, 0x00FFFFFF, 0x0100A8C0};
+            FakeNina_replyBegin(3);
+            for (int i = 0; i < 3; i++) {
+                FakeNina_replyParam(&addr[i], 4);
+            }
+            break;
+        }
+
+        case GET_MACADDR_CMD:
+        case GET_CURR_BSSID_CMD:
+            memcpy(buf, "\x02\x00\x00\x12\x34\x56", WL_MAC_ADDR_LENGTH);
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam(buf, WL_MAC_ADDR_LENGTH);
+            break;
+
+        case GET_CURR_SSID_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam("fake-ssid", 9);
+            break;
+
+        case GET_CURR_RSSI_CMD:
+            value = (uint32) -42;
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam(&value, 4);
+            break;
+
+        case GET_CURR_ENCT_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(ENC_TYPE_CCMP);
+            break;
+
+        case GET_FW_VERSION_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam("1.4.8", 5);
+            break;
+
+        case START_SCAN_NETWORKS:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(1);
+            break;
+
+        case SCAN_NETWORKS:
+            FakeNina_replyBegin(FakeNina_networks);
+            for (uint8 i = 0; i < FakeNina_networks; i++) {
+                FakeNina_replyParam(buf, snprintf((char *) buf, sizeof(buf), "net%u", i));
+            }
+            break;
+
+        case GET_IDX_RSSI_CMD:
+            value = (uint32) (-40 - f->param[0][0]);
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam(&value, 4);
+            break;
+
+        case GET_IDX_ENCT_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(ENC_TYPE_CCMP);
+            break;
+
+        case GET_IDX_BSSID:
+            memcpy(buf, "\x02\x00\x00\x00\x00\x00", WL_MAC_ADDR_LENGTH);
+            buf[WL_MAC_ADDR_LENGTH - 1] = f->param[0][0];
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam(buf, WL_MAC_ADDR_LENGTH);
+            break;
+
+        case GET_IDX_CHANNEL_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(1 + f->param[0][0] % 11);
+            break;
+
+        case REQ_HOST_BY_NAME_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(1);
+            break;
+
+        case GET_HOST_BY_NAME_CMD:
+            value = 0x0100000A;
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam(&value, 4);
+            break;
+
+        case GET_SOCKET_CMD: {
+            uint8 sock = NO_SOCKET_AVAIL;
+            for (uint8 i = 0; i < FAKE_NINA_NUM_SOCKETS; i++) {
+                if (!FakeNina_sockets[i].inUse) {
+                    sock = i;
+                    break;
+                }
+            }
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(sock);
+            break;
+        }
+
+        // The socket is the third parameter, after the address and port
+        case START_CLIENT_TCP_CMD:
+        case START_SERVER_TCP_CMD: {
+            uint8 n = (f->cmd == START_CLIENT_TCP_CMD) ? 2 : 1;
+            uint8 sock = (f->numParam > n) ? f->param[n][0] : NO_SOCKET_AVAIL;
+            uint8 ok = sock < FAKE_NINA_NUM_SOCKETS;
+            if (ok) {
+                FakeNina_sockets[sock].inUse = 1;
+                FakeNina_sockets[sock].state = (f->cmd == START_CLIENT_TCP_CMD) ? ESTABLISHED : LISTEN;
+                FakeNina_sockets[sock].client = NO_SOCKET_AVAIL;
+            }
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(ok);
+            break;
+        }
+
+        case STOP_CLIENT_TCP_CMD:
+            if (socket) {
+                socket->inUse = 0;
+                socket->state = CLOSED;
+            }
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(socket != NULL);
+            break;
+
+        case GET_STATE_TCP_CMD:
+        case GET_CLIENT_STATE_TCP_CMD:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(socket ? socket->state : CLOSED);
+            break;
+
+        // A server socket gives a client with data waiting instead
+        case AVAIL_DATA_TCP_CMD: {
+            uint16 avail = socket ? socket->rxLength - socket->rxPos : 0;
+            if (socket && socket->state == LISTEN) {
+                avail = socket->client;
+            }
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam(&avail, 2);
+            break;
+        }
+
+        case GET_DATA_TCP_CMD:
+            FakeNina_replyBegin(1);
+            if (socket && socket->rxPos < socket->rxLength) {
+                FakeNina_replyByte(socket->rxData[socket->rxPos]);
+                if (!f->param[1][0]) {
+                    socket->rxPos++;
+                }
+            } else {
+                FakeNina_replyParam(NULL, 0);
+            }
+            break;
+
+        case GET_DATABUF_TCP_CMD: {
+            uint16 want;
+            uint32 have = socket ? socket->rxLength - socket->rxPos : 0;
+            memcpy(&want, f->param[1], 2);
+            if (want > have) {
+                want = have;
+            }
+            FakeNina_replyBegin(1);
+            FakeNina_replyParam(want ? socket->rxData + socket->rxPos : NULL, want);
+            if (socket) {
+                socket->rxPos += want;
+            }
+            break;
+        }
+
+        case SEND_DATA_TCP_CMD:
+        case INSERT_DATABUF_CMD: {
+            uint16 length = f->paramLen[1];
+            if (socket && socket->txLength + length <= FAKE_NINA_TX_SIZE) {
+                memcpy(socket->txData + socket->txLength, f->param[1], length);
+                socket->txLength += length;
+            } else {
+                length = 0;
+            }
+            FakeNina_replyBegin(1);
+            if (f->cmd == SEND_DATA_TCP_CMD) {
+                FakeNina_replyParam(&length, 2);
+            } else {
+                FakeNina_replyByte(length != 0);
+            }
+            break;
+        }
+
+        case DATA_SENT_TCP_CMD:
+            if (socket) {
+                socket->dataSent++;
+            }
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(1);
+            break;
+
+        case SEND_DATA_UDP_CMD:
+        case DISCONNECT_CMD:
+        case SET_NET_CMD:
+        case SET_PASSPHRASE_CMD:
+        case SET_KEY_CMD:
+        case SET_IP_CONFIG_CMD:
+        case SET_DNS_CONFIG_CMD:
+        case SET_HOSTNAME_CMD:
+        case SET_POWER_MODE_CMD:
+        case SET_DEBUG_CMD:
+        case SET_PIN_MODE:
+        case SET_DIGITAL_WRITE:
+        case SET_ANALOG_WRITE:
+            FakeNina_replyBegin(1);
+            FakeNina_replyByte(1);
+            break;
+
+        default:
+            FakeNina_stats.unknownCmds++;
+            FakeNina_replyError();
+            break;
+    }
+}
+
+static void FakeNina_frameDone(void) {
+    const FakeNinaFrame_t *f = &FakeNina_frame;
+
+    FakeNina_stats.frames++;
+    if (f->length & 3) {
+        FakeNina_stats.badFrames++;
+    }
+
+    if (FakeNina_rawLength) {
+        memcpy(FakeNina_reply, FakeNina_raw, FakeNina_rawLength);
+        FakeNina_replyLength = FakeNina_rawLength;
+        FakeNina_rawLength = 0;
+    } else if (FakeNina_failCount && f->cmd == FakeNina_failOpcode &&
+               (FakeNina_failSock < 0 || (f->numParam && f->param[0][0] == FakeNina_failSock))) {
+        FakeNina_failCount--;
+        FakeNina_replyError();
+    } else {
+        FakeNina_model();
+        if (FakeNina_reply[0] == START_CMD) {
+            FakeNina_replyEnd();
+        }
+    }
+
+    FakeNina_replyPos = 0;
+    FakeNina_state = FAKE_NINA_REPLY_PENDING;
+}
+
+static void FakeNina_frameByte(uint8 in) {
+    FakeNinaFrame_t *f = &FakeNina_frame;
+
+    if (f->length >= FAKE_NINA_MAX_FRAME) {
+        FakeNina_stats.badFrames++;
+        FakeNina_state = FAKE_NINA_WAIT_START;
+        return;
+    }
+    f->raw[f->length++] = in;
+
+    switch (FakeNina_state) {
+        case FAKE_NINA_CMD:
+            f->cmd = in & ~(REPLY_FLAG);
+            FakeNina_state = FAKE_NINA_NUM_PARAM;
+            break;
+
+        case FAKE_NINA_NUM_PARAM:
+            f->numParam = in;
+            FakeNina_param = 0;
+            FakeNina_lenPos = 0;
+            FakeNina_state = (in > 0) ? FAKE_NINA_PARAM_LEN : FAKE_NINA_END;
+            if (in > FAKE_NINA_MAX_PARAMS) {
+                FakeNina_stats.badFrames++;
+                FakeNina_state = FAKE_NINA_WAIT_START;
+            }
+            break;
+
+        case FAKE_NINA_PARAM_LEN:
+            if (FakeNina_lenPos == 0) {
+                f->paramLen[FakeNina_param] = 0;
+            }
+            f->paramLen[FakeNina_param] = (f->paramLen[FakeNina_param] << 8) | in;
+            if (++FakeNina_lenPos < FakeNina_lenSize(f->cmd)) {
+                break;
+            }
+            FakeNina_lenPos = 0;
+            FakeNina_paramPos = 0;
+            f->param[FakeNina_param] = &f->raw[f->length];
+            if (f->paramLen[FakeNina_param]) {
+                FakeNina_state = FAKE_NINA_PARAM;
+                break;
+            }
+            // An empty parameter is done already
+            FakeNina_state = (++FakeNina_param < f->numParam) ? FAKE_NINA_PARAM_LEN : FAKE_NINA_END;
+            break;
+
+        case FAKE_NINA_PARAM:
+            if (++FakeNina_paramPos < f->paramLen[FakeNina_param]) {
+                break;
+            }
+            FakeNina_state = (++FakeNina_param < f->numParam) ? FAKE_NINA_PARAM_LEN : FAKE_NINA_END;
+            break;
+
+        case FAKE_NINA_END:
+            if (in == END_CMD) {
+                FakeNina_frameDone();
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+// One byte each way
+static uint8 FakeNina_exchange(uint8 in) {
+    if (!FakeNina_selected || !FakeNina_resetPin) {
+        FakeNina_stats.unselectedBytes++;
+        return 0xFF;
+    }
+
+    switch (FakeNina_state) {
+        case FAKE_NINA_WAIT_START:
+            if (in != START_CMD) {
+                FakeNina_stats.idleBytes++;
+                return 0x00;
+            }
+            FakeNina_frame.length = 0;
+            FakeNina_frame.numParam = 0;
+            FakeNina_frame.raw[FakeNina_frame.length++] = in;
+            FakeNina_stats.frameBytes++;
+            FakeNina_state = FAKE_NINA_CMD;
+            return 0x00;
+
+        case FAKE_NINA_CMD:
+        case FAKE_NINA_NUM_PARAM:
+        case FAKE_NINA_PARAM_LEN:
+        case FAKE_NINA_PARAM:
+        case FAKE_NINA_END:
+            FakeNina_stats.frameBytes++;
+            FakeNina_frameByte(in);
+            return 0x00;
+
+        case FAKE_NINA_REPLY:
+            if (FakeNina_replyPos < FakeNina_replyLength) {
+                FakeNina_stats.replyBytes++;
+                return FakeNina_reply[FakeNina_replyPos++];
+            }
+            FakeNina_stats.idleBytes++;
+            return 0x00;
+
+        default:
+            // Still working on the command as far as the host should know
+            FakeNina_stats.idleBytes++;
+            return 0x00;
+    }
+}
+
+void FakeNina_reset(void) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    memset(&FakeNina_stats, 0x00, sizeof(FakeNina_stats));
+    memset(FakeNina_sockets, 0x00, sizeof(FakeNina_sockets));
+    memset(&FakeNina_frame, 0x00, sizeof(FakeNina_frame));
+    FakeNina_state = FAKE_NINA_WAIT_START;
+    FakeNina_status = WL_IDLE_STATUS;
+    FakeNina_networks = 0;
+    FakeNina_failCount = 0;
+    FakeNina_rawLength = 0;
+    FakeNina_preempt = 0;
+    FakeSpim_rxHead = 0;
+    FakeSpim_rxCount = 0;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+FakeNinaSocket_t *FakeNina_socket(uint8 sock) {
+    return &FakeNina_sockets[sock];
+}
+
+void FakeNina_setRx(uint8 sock, uint8 state, const uint8 *data, uint32 length) {
+    FakeNinaSocket_t *socket = &FakeNina_sockets[sock];
+
+    pthread_mutex_lock(&FakeNina_mutex);
+    socket->inUse = 1;
+    socket->state = state;
+    socket->rxData = data;
+    socket->rxLength = length;
+    socket->rxPos = 0;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void FakeNina_setStatus(uint8 status) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    FakeNina_status = status;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void FakeNina_setNetworks(uint8 count) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    FakeNina_networks = count;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void FakeNina_failCmd(uint8 cmd, int sock, int count) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    FakeNina_failOpcode = cmd;
+    FakeNina_failSock = sock;
+    FakeNina_failCount = count;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void FakeNina_replyRaw(const uint8 *reply, uint16 length) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    memcpy(FakeNina_raw, reply, length);
+    FakeNina_rawLength = length;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void FakeNina_setPreempt(uint8 preempt) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    FakeNina_preempt = preempt;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void FakeNina_lock(void) {
+    pthread_mutex_lock(&FakeNina_mutex);
+}
+
+void FakeNina_unlock(void) {
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+const FakeNinaFrame_t *FakeNina_lastFrame(void) {
+    return &FakeNina_frame;
+}
+
+void FakeNina_getStats(FakeNinaStats_t *stats) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    *stats = FakeNina_stats;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void FakeNina_resetStats(void) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    memset(&FakeNina_stats, 0x00, sizeof(FakeNina_stats));
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+// Bytes from a task other than the one that selected us mean two tasks are on the bus at once
+static void FakeNina_checkOwner(void) {
+    if (FakeNina_selected && !pthread_equal(FakeNina_selectedBy, pthread_self())) {
+        FakeNina_stats.clashes++;
+    }
+}
+
+void FakeNina_clock(const uint8 *out, uint8 *in, uint16 len) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    FakeNina_stats.transfers++;
+    FakeNina_checkOwner();
+
+    for (uint16 i = 0; i < len; i++) {
+        in[i] = FakeNina_exchange(out[i]);
+    }
+    uint8 preempt = FakeNina_preempt;
+    pthread_mutex_unlock(&FakeNina_mutex);
+
+    // Let other tasks in while the transfer is "on the wire", as a real one would
+    if (preempt) {
+        sched_yield();
+    }
+}
+
+// SPIM_WIFI: everything put in is clocked out at once, what comes back lands in the Rx buffer
+void SPIM_WIFI_PutArray(const uint8 buffer[], uint8 byteCount) {
+    uint8 in[0x100];
+
+    FakeNina_clock(buffer, in, byteCount);
+
+    pthread_mutex_lock(&FakeNina_mutex);
+    for (uint8 i = 0; i < byteCount; i++) {
+        if (FakeSpim_rxCount < FAKE_SPIM_RX_SIZE) {
+            FakeSpim_rx[(FakeSpim_rxHead + FakeSpim_rxCount++) % FAKE_SPIM_RX_SIZE] = in[i];
+        }
+    }
+    pthread_mutex_unlock(&FakeNina_mutex);
+
+    // Transfer done, as the real Tx interrupt would report it
+    FakeSpim_status |= SPIM_WIFI_INT_ON_SPI_DONE;
+    SPIM_WIFI_TX_ISR_EntryCallback();
+    SPIM_WIFI_TX_ISR_ExitCallback();
+    FakeSpim_status = 0;
+}
+
+uint8 SPIM_WIFI_GetRxBufferSize(void) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    uint8 size = (FakeSpim_rxCount > 0xFF) ? 0xFF : FakeSpim_rxCount;
+    pthread_mutex_unlock(&FakeNina_mutex);
+    return size;
+}
+
+uint8 SPIM_WIFI_ReadRxData(void) {
+    uint8 data = 0;
+
+    pthread_mutex_lock(&FakeNina_mutex);
+    if (FakeSpim_rxCount) {
+        data = FakeSpim_rx[FakeSpim_rxHead];
+        FakeSpim_rxHead = (FakeSpim_rxHead + 1) % FAKE_SPIM_RX_SIZE;
+        FakeSpim_rxCount--;
+    }
+    pthread_mutex_unlock(&FakeNina_mutex);
+    return data;
+}
+
+void SPIM_WIFI_ClearTxBuffer(void) {
+}
+
+void SPIM_WIFI_ClearRxBuffer(void) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    FakeSpim_rxHead = 0;
+    FakeSpim_rxCount = 0;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+// Always ready: the model answers as soon as the frame is in
+uint8 ESPBUSY_Read(void) {
+    return 0;
+}
+
+void ESPRST_Write(uint8 value) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    if (value && !FakeNina_resetPin) {
+        FakeNina_stats.resets++;
+        FakeNina_state = FAKE_NINA_WAIT_START;
+    }
+    FakeNina_resetPin = value;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
+
+void WIFI_CS_OVERRIDE_Write(uint8 value) {
+    pthread_mutex_lock(&FakeNina_mutex);
+    if (value && !FakeNina_selected) {
+        FakeNina_stats.selects++;
+        FakeNina_selectedBy = pthread_self();
+        if (FakeNina_state == FAKE_NINA_REPLY_READY) {
+            FakeNina_state = FAKE_NINA_REPLY;
+        }
+    } else if (value) {
+        // Selected again while still selected: someone else's frame is in progress
+        FakeNina_checkOwner();
+    } else if (FakeNina_selected) {
+        FakeNina_checkOwner();
+        if (FakeNina_state == FAKE_NINA_REPLY_PENDING) {
+            FakeNina_state = FAKE_NINA_REPLY_READY;
+        } else if (FakeNina_state == FAKE_NINA_REPLY) {
+            // Whatever the host didn't read is gone
+            FakeNina_state = FAKE_NINA_WAIT_START;
+        }
+    }
+    FakeNina_selected = value;
+    pthread_mutex_unlock(&FakeNina_mutex);
+}
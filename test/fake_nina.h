@@ -0,0 +1,117 @@
+/*
+  fake_nina.h - SPIM, pins and a scripted NINA co-processor for the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FakeNina_h
+#define FakeNina_h
+
+#include "project.h"
+
+/*
+ * Stands in for SPIM_WIFI, ESPBUSY, ESPRST and the chip select override, with a NINA on the other
+ * end.  It takes command frames the way the firmware does (START_CMD .. END_CMD, 16 bit parameter
+ * lengths for DATA_FLAG commands, padded to 4 bytes) and makes the reply readable on the next
+ * slave select.  Replies come from a small model of the firmware, see fake_nina.c, unless a test
+ * scripts one with FakeNina_failCmd or FakeNina_replyRaw.
+ */
+
+#ifndef FAKE_NINA_MAX_FRAME
+#define FAKE_NINA_MAX_FRAME 4096
+#endif
+
+#define FAKE_NINA_MAX_PARAMS 16
+#define FAKE_NINA_NUM_SOCKETS 10
+#define FAKE_NINA_TX_SIZE 8192
+
+// The last command frame as it came off the wire
+typedef struct _FakeNinaFrame {
+    uint8 cmd;
+    uint8 numParam;
+    uint16 paramLen[FAKE_NINA_MAX_PARAMS];
+    const uint8 *param[FAKE_NINA_MAX_PARAMS];
+    uint16 length;      // START_CMD to END_CMD, padding included
+    uint8 raw[FAKE_NINA_MAX_FRAME];
+} FakeNinaFrame_t;
+
+typedef struct _FakeNinaStats {
+    uint32 transfers;       // SPIM_WIFI_PutArray calls
+    uint32 selects;         // slave selects, each one a ready handshake
+    uint32 frames;          // command frames taken in
+    uint32 badFrames;       // frames that were not padded to a multiple of 4, or too long
+    uint32 unknownCmds;     // commands the model doesn't know, answered with ERR_CMD
+    uint32 frameBytes;      // clocked while a command frame was coming in
+    uint32 replyBytes;      // reply bytes clocked out to the host
+    uint32 idleBytes;       // clocked with nothing going either way, i.e. wasted dummy bytes
+    uint32 unselectedBytes; // clocked without the slave selected
+    uint32 clashes;         // bytes or a select from a task other than the one that has us selected
+    uint32 resets;
+} FakeNinaStats_t;
+
+// A socket as the model firmware sees it.  Tests set state and the data waiting to be read.
+typedef struct _FakeNinaSocket {
+    uint8 state;
+    uint8 inUse;
+    const uint8 *rxData;
+    uint32 rxLength;
+    uint32 rxPos;
+    uint8 txData[FAKE_NINA_TX_SIZE];
+    uint32 txLength;
+    uint8 client;       // listening: the client AVAIL_DATA_TCP_CMD reports, NO_SOCKET_AVAIL for none
+    uint32 dataSent;    // DATA_SENT_TCP_CMD queries
+} FakeNinaSocket_t;
+
+// Back to power on: no sockets, nothing scripted, counters cleared
+void FakeNina_reset(void);
+
+// Hold around changes to a socket while other tasks may be using the bus
+void FakeNina_lock(void);
+void FakeNina_unlock(void);
+
+FakeNinaSocket_t *FakeNina_socket(uint8 sock);
+
+// Give socket sock length bytes to be read, and the TCP state to report
+void FakeNina_setRx(uint8 sock, uint8 state, const uint8 *data, uint32 length);
+
+// What GET_CONN_STATUS_CMD reports
+void FakeNina_setStatus(uint8 status);
+
+// How many networks SCAN_NETWORKS reports, named "net0", "net1", ...
+void FakeNina_setNetworks(uint8 count);
+
+/*
+ * Answer the next count commands cmd with ERR_CMD.  If sock is not -1 only commands whose first
+ * parameter is that socket count.
+ */
+void FakeNina_failCmd(uint8 cmd, int sock, int count);
+
+// Answer the next command, whatever it is, with exactly these bytes
+void FakeNina_replyRaw(const uint8 *reply, uint16 length);
+
+// Clock len bytes each way in one transfer, for the SPIM and the fake DMA
+void FakeNina_clock(const uint8 *out, uint8 *in, uint16 len);
+
+// Yield to other tasks after every transfer, so they get to run with a transaction half done
+void FakeNina_setPreempt(uint8 preempt);
+
+const FakeNinaFrame_t *FakeNina_lastFrame(void);
+
+void FakeNina_getStats(FakeNinaStats_t *stats);
+
+void FakeNina_resetStats(void);
+
+#endif
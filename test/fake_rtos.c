@@ -0,0 +1,449 @@
+/*
+  fake_rtos.c - FreeRTOS stand-in on POSIX threads for the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#define _GNU_SOURCE
+
+#include "fake_rtos.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define FAKE_RTOS_MAX_TASKS 32
+
+typedef struct _FakeRtosTask {
+    uint8_t used;
+    uint8_t blocked;
+    uint8_t hasDeadline;
+    TickType_t deadline;
+    const char *name;
+    const char *waitingIn;
+    TaskFunction_t code;
+    void *param;
+    pthread_t thread;
+    uint32_t notifications[configTASK_NOTIFICATION_ARRAY_ENTRIES];
+} FakeRtosTask_t;
+
+struct _FakeRtosSemaphore {
+    UBaseType_t count;
+    UBaseType_t max;
+};
+
+struct _FakeRtosQueue {
+    uint8_t *items;
+    UBaseType_t itemSize;
+    UBaseType_t length;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+/*
+ * Every task is a thread, and all of the kernel state below is under FakeRtos_lock.  Time is
+ * virtual: it only moves on once every task is blocked in here, and then straight to the
+ * earliest deadline.  So delays and timeouts cost nothing, runs repeat, and if every task is
+ * blocked with no deadline that's a deadlock and we abort rather than hang.
+ */
+static pthread_mutex_t FakeRtos_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t FakeRtos_changed = PTHREAD_COND_INITIALIZER;
+static FakeRtosTask_t FakeRtos_tasks[FAKE_RTOS_MAX_TASKS];
+static int FakeRtos_alive = 0;
+static int FakeRtos_blocked = 0;
+static TickType_t FakeRtos_tick = 0;
+
+// taskENTER_CRITICAL keeps every other task out, like interrupts off on a single core
+static pthread_mutex_t FakeRtos_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread int FakeRtos_nesting = 0;
+
+static __thread FakeRtosTask_t *FakeRtos_self = NULL;
+
+
+static FakeRtosTask_t *FakeRtos_allocate(const char *name) {
+    for (int i = 0; i < FAKE_RTOS_MAX_TASKS; i++) {
+        if (!FakeRtos_tasks[i].used) {
+            memset(&FakeRtos_tasks[i], 0x00, sizeof(FakeRtosTask_t));
+            FakeRtos_tasks[i].used = 1;
+            FakeRtos_tasks[i].name = name;
+            FakeRtos_alive++;
+            return &FakeRtos_tasks[i];
+        }
+    }
+
+    fprintf(stderr, "fake_rtos: more than %d tasks\n", FAKE_RTOS_MAX_TASKS);
+    abort();
+}
+
+// The calling thread's task.  The main thread becomes one the first time it gets here.
+static FakeRtosTask_t *FakeRtos_current(void) {
+    if (!FakeRtos_self) {
+        FakeRtos_self = FakeRtos_allocate("main");
+        FakeRtos_self->thread = pthread_self();
+    }
+    return FakeRtos_self;
+}
+
+static void FakeRtos_wakeAll(void) {
+    for (int i = 0; i < FAKE_RTOS_MAX_TASKS; i++) {
+        FakeRtos_tasks[i].blocked = 0;
+    }
+    FakeRtos_blocked = 0;
+    pthread_cond_broadcast(&FakeRtos_changed);
+}
+
+// Everybody is waiting on something: move time on to whoever is due first
+static void FakeRtos_checkIdle(void) {
+    FakeRtosTask_t *next = NULL;
+
+    if (FakeRtos_alive == 0 || FakeRtos_blocked < FakeRtos_alive) {
+        return;
+    }
+
+    for (int i = 0; i < FAKE_RTOS_MAX_TASKS; i++) {
+        FakeRtosTask_t *task = &FakeRtos_tasks[i];
+        if (task->used && task->blocked && task->hasDeadline &&
+            (!next || (TickType_t) (task->deadline - FakeRtos_tick) < (TickType_t) (next->deadline - FakeRtos_tick))) {
+            next = task;
+        }
+    }
+
+    if (!next) {
+        fprintf(stderr, "fake_rtos: deadlock, every task is blocked forever:\n");
+        for (int i = 0; i < FAKE_RTOS_MAX_TASKS; i++) {
+            if (FakeRtos_tasks[i].used) {
+                fprintf(stderr, "  %s in %s\n", FakeRtos_tasks[i].name, FakeRtos_tasks[i].waitingIn);
+            }
+        }
+        abort();
+    }
+
+    FakeRtos_tick = next->deadline;
+    FakeRtos_wakeAll();
+}
+
+/*
+ * Block until something changes.  Called with FakeRtos_lock held, in a loop that checks what it
+ * is waiting for.  Returns 0 once timeout ticks have passed since start.
+ */
+static int FakeRtos_wait(TickType_t start, TickType_t timeout, const char *what) {
+    FakeRtosTask_t *self = FakeRtos_current();
+
+    if (timeout != portMAX_DELAY && FakeRtos_tick - start >= timeout) {
+        return 0;
+    }
+
+    if (FakeRtos_nesting) {
+        fprintf(stderr, "fake_rtos: %s blocked in %s inside a critical section\n", self->name, what);
+        abort();
+    }
+
+    self->blocked = 1;
+    self->hasDeadline = (timeout != portMAX_DELAY);
+    self->deadline = start + timeout;
+    self->waitingIn = what;
+    FakeRtos_blocked++;
+    FakeRtos_checkIdle();
+
+    while (self->blocked) {
+        pthread_cond_wait(&FakeRtos_changed, &FakeRtos_lock);
+    }
+    return 1;
+}
+
+static void *FakeRtos_run(void *arg) {
+    FakeRtosTask_t *task = arg;
+
+    FakeRtos_self = task;
+    task->code(task->param);
+
+    // Returning is as good as vTaskDelete(NULL)
+    vTaskDelete(NULL);
+    return NULL;
+}
+
+void FakeRtos_reset(void) {
+    pthread_mutex_lock(&FakeRtos_lock);
+    memset(FakeRtos_current()->notifications, 0x00, sizeof(FakeRtos_current()->notifications));
+    pthread_mutex_unlock(&FakeRtos_lock);
+}
+
+void FakeRtos_advance(TickType_t ticks) {
+    pthread_mutex_lock(&FakeRtos_lock);
+    FakeRtos_tick += ticks;
+    FakeRtos_wakeAll();
+    pthread_mutex_unlock(&FakeRtos_lock);
+}
+
+int FakeRtos_criticalNesting(void) {
+    return FakeRtos_nesting;
+}
+
+void vPortEnterCritical(void) {
+    pthread_mutex_lock(&FakeRtos_critical);
+    FakeRtos_nesting++;
+}
+
+void vPortExitCritical(void) {
+    if (FakeRtos_nesting <= 0) {
+        fprintf(stderr, "fake_rtos: taskEXIT_CRITICAL without taskENTER_CRITICAL\n");
+        abort();
+    }
+    FakeRtos_nesting--;
+    pthread_mutex_unlock(&FakeRtos_critical);
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint16_t stackDepth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle) {
+    FakeRtosTask_t *task;
+
+    (void) stackDepth;
+    (void) priority;
+
+    pthread_mutex_lock(&FakeRtos_lock);
+    FakeRtos_current();
+    // Counted from now on, so time can't run ahead before the thread gets going
+    task = FakeRtos_allocate(name);
+    task->code = code;
+    task->param = param;
+    if (handle) {
+        *handle = task;
+    }
+    pthread_mutex_unlock(&FakeRtos_lock);
+
+    if (pthread_create(&task->thread, NULL, FakeRtos_run, task) != 0) {
+        fprintf(stderr, "fake_rtos: can't start %s\n", name);
+        abort();
+    }
+    pthread_detach(task->thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t handle) {
+    FakeRtosTask_t *task = handle ? handle : FakeRtos_current();
+
+    if (task != FakeRtos_self) {
+        fprintf(stderr, "fake_rtos: only a task's own vTaskDelete(NULL) is supported\n");
+        abort();
+    }
+
+    pthread_mutex_lock(&FakeRtos_lock);
+    task->used = 0;
+    FakeRtos_alive--;
+    FakeRtos_checkIdle();
+    pthread_mutex_unlock(&FakeRtos_lock);
+
+    pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    pthread_mutex_lock(&FakeRtos_lock);
+    TickType_t start = FakeRtos_tick;
+    while (FakeRtos_wait(start, ticks, "vTaskDelay")) {
+    }
+    pthread_mutex_unlock(&FakeRtos_lock);
+
+    if (ticks == 0) {
+        sched_yield();
+    }
+}
+
+TickType_t xTaskGetTickCount(void) {
+    pthread_mutex_lock(&FakeRtos_lock);
+    TickType_t tick = FakeRtos_tick;
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return tick;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    pthread_mutex_lock(&FakeRtos_lock);
+    FakeRtosTask_t *self = FakeRtos_current();
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return self;
+}
+
+static void FakeRtos_checkIndex(UBaseType_t index) {
+    if (index >= configTASK_NOTIFICATION_ARRAY_ENTRIES) {
+        fprintf(stderr, "fake_rtos: notification index %lu out of range\n", (unsigned long) index);
+        abort();
+    }
+}
+
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t handle, UBaseType_t index) {
+    FakeRtosTask_t *task = handle;
+
+    FakeRtos_checkIndex(index);
+    pthread_mutex_lock(&FakeRtos_lock);
+    task->notifications[index]++;
+    FakeRtos_wakeAll();
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t timeout) {
+    uint32_t value = 0;
+
+    FakeRtos_checkIndex(index);
+    pthread_mutex_lock(&FakeRtos_lock);
+    FakeRtosTask_t *self = FakeRtos_current();
+    TickType_t start = FakeRtos_tick;
+
+    while (!self->notifications[index] && FakeRtos_wait(start, timeout, "ulTaskNotifyTake")) {
+    }
+
+    value = self->notifications[index];
+    if (value) {
+        self->notifications[index] = clear ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return value;
+}
+
+static SemaphoreHandle_t FakeRtos_createSemaphore(UBaseType_t count, UBaseType_t max) {
+    SemaphoreHandle_t semaphore = calloc(1, sizeof(*semaphore));
+
+    if (semaphore) {
+        semaphore->count = count;
+        semaphore->max = max;
+    }
+    return semaphore;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return FakeRtos_createSemaphore(0, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max, UBaseType_t initial) {
+    return FakeRtos_createSemaphore(initial, max);
+}
+
+// No priorities here, so there is no inheritance to worry about
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return FakeRtos_createSemaphore(1, 1);
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    BaseType_t taken = pdFALSE;
+
+    pthread_mutex_lock(&FakeRtos_lock);
+    TickType_t start = FakeRtos_tick;
+    while (!semaphore->count && FakeRtos_wait(start, timeout, "xSemaphoreTake")) {
+    }
+    if (semaphore->count) {
+        semaphore->count--;
+        taken = pdTRUE;
+    }
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    BaseType_t given = pdFALSE;
+
+    pthread_mutex_lock(&FakeRtos_lock);
+    if (semaphore->count < semaphore->max) {
+        semaphore->count++;
+        given = pdTRUE;
+        FakeRtos_wakeAll();
+    }
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return given;
+}
+
+BaseType_t xSemaphoreGiveFromISR(SemaphoreHandle_t semaphore, BaseType_t *woken) {
+    if (woken) {
+        *woken = pdFALSE;
+    }
+    return xSemaphoreGive(semaphore);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    QueueHandle_t queue = calloc(1, sizeof(*queue));
+
+    if (queue) {
+        queue->items = calloc(length, itemSize);
+        queue->itemSize = itemSize;
+        queue->length = length;
+    }
+    return queue;
+}
+
+static BaseType_t FakeRtos_queueSend(QueueHandle_t queue, const void *item, TickType_t timeout, int front) {
+    BaseType_t sent = pdFALSE;
+
+    pthread_mutex_lock(&FakeRtos_lock);
+    TickType_t start = FakeRtos_tick;
+    while (queue->count == queue->length && FakeRtos_wait(start, timeout, "xQueueSend")) {
+    }
+
+    if (queue->count < queue->length) {
+        UBaseType_t slot;
+        if (front) {
+            queue->head = (queue->head + queue->length - 1) % queue->length;
+            slot = queue->head;
+        } else {
+            slot = (queue->head + queue->count) % queue->length;
+        }
+        memcpy(queue->items + slot * queue->itemSize, item, queue->itemSize);
+        queue->count++;
+        sent = pdTRUE;
+        FakeRtos_wakeAll();
+    }
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return sent;
+}
+
+BaseType_t xQueueSendToBack(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    return FakeRtos_queueSend(queue, item, timeout, 0);
+}
+
+BaseType_t xQueueSendToFront(QueueHandle_t queue, const void *item, TickType_t timeout) {
+    return FakeRtos_queueSend(queue, item, timeout, 1);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t timeout) {
+    BaseType_t received = pdFALSE;
+
+    pthread_mutex_lock(&FakeRtos_lock);
+    TickType_t start = FakeRtos_tick;
+    while (!queue->count && FakeRtos_wait(start, timeout, "xQueueReceive")) {
+    }
+
+    if (queue->count) {
+        memcpy(item, queue->items + queue->head * queue->itemSize, queue->itemSize);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        received = pdTRUE;
+        FakeRtos_wakeAll();
+    }
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return received;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+    pthread_mutex_lock(&FakeRtos_lock);
+    UBaseType_t count = queue->count;
+    pthread_mutex_unlock(&FakeRtos_lock);
+    return count;
+}
@@ -0,0 +1,41 @@
+/*
+  fake_rtos.h - FreeRTOS stand-in on POSIX threads for the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FakeRtos_h
+#define FakeRtos_h
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/*
+ * Each task is a thread, the test's main thread included.  Time is virtual: ticks only move once
+ * every task is blocked, straight to the earliest deadline, so timeouts cost nothing.  Every task
+ * blocked with nothing due is a deadlock and aborts.
+ */
+
+// Clear the calling task's notifications.  Time carries on, other tasks are left alone.
+void FakeRtos_reset(void);
+
+// Move time on, as if the task had been blocked for ticks
+void FakeRtos_advance(TickType_t ticks);
+
+// The calling task's critical section nesting, 0 whenever the library is back in the test's hands
+int FakeRtos_criticalNesting(void);
+
+#endif
@@ -0,0 +1,105 @@
+/*
+  project.h - Host stand-in for the PSoC Creator generated project.h
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef project_h
+#define project_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// cytypes.h
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+typedef int8_t int8;
+typedef int16_t int16;
+typedef int32_t int32;
+
+#define HI16(x) ((uint16) ((uint32) (x) >> 16))
+#define LO16(x) ((uint16) ((uint32) (x)))
+
+typedef volatile uint8 reg8;
+typedef uint32 cystatus;
+typedef void (*cyisraddress)(void);
+
+#define CY_ISR(name)        void name(void)
+#define CY_ISR_PROTO(name)  void name(void)
+
+// cydevice.h, the PSoC 5LP memory map as far as the DMA cares
+#define CYDEV_SRAM_BASE     0x1FFF8000u
+#define CYDEV_SRAM_SIZE     0x00010000u
+#define CYDEV_FLASH_BASE    0x00000000u
+#define CYDEV_PERIPH_BASE   0x40000000u
+
+// SPIM_WIFI, backed by the fake NINA in fake_nina.c
+extern volatile uint8 FakeSpim_status;
+
+#define SPIM_WIFI_STATUS            FakeSpim_status
+#define SPIM_WIFI_STATUS_MASK       0x3F
+#define SPIM_WIFI_INT_ON_SPI_DONE   0x01
+
+void SPIM_WIFI_PutArray(const uint8 buffer[], uint8 byteCount);
+uint8 SPIM_WIFI_GetRxBufferSize(void);
+uint8 SPIM_WIFI_ReadRxData(void);
+void SPIM_WIFI_ClearTxBuffer(void);
+void SPIM_WIFI_ClearRxBuffer(void);
+
+// The SPIM Tx ISR callbacks the driver provides
+void SPIM_WIFI_TX_ISR_EntryCallback(void);
+void SPIM_WIFI_TX_ISR_ExitCallback(void);
+
+// SPIM_WIFI FIFO registers, only ever handed to the DMA
+extern reg8 FakeSpim_txData;
+extern reg8 FakeSpim_rxData;
+
+#define SPIM_WIFI_TXDATA_PTR        (&FakeSpim_txData)
+#define SPIM_WIFI_RXDATA_PTR        (&FakeSpim_rxData)
+
+// CyDmac.h, DMA_WIFI_TX, DMA_WIFI_RX and isr_WIFI_DMA_RX, backed by the fake DMA in fake_dma.c
+#define CY_DMA_DISABLE_TD           0xFEu
+#define TD_TERMOUT0_EN              0x04u
+#define TD_INC_DST_ADR              0x02u
+#define TD_INC_SRC_ADR              0x01u
+#define DMA_WIFI_RX__TD_TERMOUT_EN  TD_TERMOUT0_EN
+
+uint8 DMA_WIFI_TX_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress,
+                                uint16 upperDestAddress);
+uint8 DMA_WIFI_RX_DmaInitialize(uint8 burstCount, uint8 requestPerBurst, uint16 upperSrcAddress,
+                                uint16 upperDestAddress);
+uint8 CyDmaTdAllocate(void);
+cystatus CyDmaTdSetConfiguration(uint8 tdHandle, uint16 transferCount, uint8 nextTd, uint8 configuration);
+cystatus CyDmaTdSetAddress(uint8 tdHandle, uint16 source, uint16 destination);
+cystatus CyDmaChSetInitialTd(uint8 chHandle, uint8 startTd);
+cystatus CyDmaChEnable(uint8 chHandle, uint8 preserveTds);
+void isr_WIFI_DMA_RX_StartEx(cyisraddress address);
+
+// Host pointers don't fit the DMA's 32 bit bus, fake_dma.c hands out addresses that stand for them
+uint32 FakeDma_address(const volatile void *ptr);
+
+#define SPI_DMA_ADDRESS(ptr)        FakeDma_address(ptr)
+
+// Pins
+uint8 ESPBUSY_Read(void);
+void ESPRST_Write(uint8 value);
+void WIFI_CS_OVERRIDE_Write(uint8 value);
+
+// The ESPBUSY falling edge interrupt callback the driver provides
+void ESP_BUSY_IRQ_Interrupt_InterruptCallback(void);
+
+#endif
@@ -0,0 +1,50 @@
+/*
+  task.h - Host stand-in for FreeRTOS task.h
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef task_h
+#define task_h
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define taskENTER_CRITICAL() vPortEnterCritical()
+#define taskEXIT_CRITICAL()  vPortExitCritical()
+
+#define tskIDLE_PRIORITY 0
+
+// Each task is a thread.  Priorities and stack depth are ignored.
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name, uint16_t stackDepth, void *param,
+                       UBaseType_t priority, TaskHandle_t *handle);
+
+// Only vTaskDelete(NULL), from the task itself
+void vTaskDelete(TaskHandle_t handle);
+
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount(void);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+BaseType_t xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index);
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear, TickType_t timeout);
+
+#define xTaskNotifyGive(task) xTaskNotifyGiveIndexed((task), 0)
+#define ulTaskNotifyTake(clear, timeout) ulTaskNotifyTakeIndexed(0, (clear), (timeout))
+
+#endif
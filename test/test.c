@@ -0,0 +1,37 @@
+/*
+  test.c - Checks shared by the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "spi_drv.h"
+
+int Test_failures = 0;
+int Test_checks = 0;
+
+void Test_setup(void) {
+    FakeRtos_reset();
+    FakeNina_reset();
+    SpiDrv_begin();
+    FakeNina_resetStats();
+    FakeDma_resetStats();
+}
+
+int Test_report(const char *name) {
+    printf("%s: %d checks, %d failed\n", name, Test_checks, Test_failures);
+    return Test_failures ? 1 : 0;
+}
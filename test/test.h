@@ -0,0 +1,71 @@
+/*
+  test.h - Checks shared by the host tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef Test_h
+#define Test_h
+
+#include <stdio.h>
+
+#include "fake_dma.h"
+#include "fake_nina.h"
+#include "fake_rtos.h"
+
+/*
+ * Each test program is a list of void functions.  CHECK records a failure and carries on so one
+ * run shows everything that's broken; the program exits non-zero if anything failed.
+ */
+
+extern int Test_failures;
+extern int Test_checks;
+
+#define CHECK(cond) \
+    do { \
+        Test_checks++; \
+        if (!(cond)) { \
+            Test_failures++; \
+            printf("%s:%d: %s: CHECK(%s) failed\n", __FILE__, __LINE__, __func__, #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        long _a = (long) (a); \
+        long _b = (long) (b); \
+        Test_checks++; \
+        if (_a != _b) { \
+            Test_failures++; \
+            printf("%s:%d: %s: %s == %s failed, %ld != %ld\n", __FILE__, __LINE__, __func__, \
+                   #a, #b, _a, _b); \
+        } \
+    } while (0)
+
+#define RUN(test) \
+    do { \
+        Test_setup(); \
+        test(); \
+        CHECK_EQ(FakeRtos_criticalNesting(), 0); \
+    } while (0)
+
+// Fresh NINA, fresh RTOS, and the driver brought up
+void Test_setup(void);
+
+// Print the totals, returns the exit code
+int Test_report(const char *name);
+
+#endif
@@ -0,0 +1,224 @@
+/*
+  test_bus_lock.c - Several tasks sharing the SPI bus
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "semphr.h"
+#include "spi_drv.h"
+#include "server_drv.h"
+
+#include <string.h>
+
+/*
+ * Each worker task reads its own socket, whose data says which socket and which offset every byte
+ * came from.  A reply that went to the wrong task, or lost its place in the stream, shows up as a
+ * byte that doesn't belong.  The workers keep their own tally, CHECK is only used from main.
+ */
+
+#define TEST_WORKERS 4
+#define TEST_STREAM_LENGTH 3000
+#define TEST_CHUNK 100
+#define TEST_MAX_READS 1000   // a worker whose stream stopped making sense gives up
+
+typedef struct _TestWorker {
+    uint8 sock;
+    uint32 read;
+    uint32 reads;
+    uint32 timeouts;
+    uint32 errors;
+    TickType_t firstTimeoutTicks;
+    uint8 untouched;    // the buffer and the stream were left as they were by a timed out read
+} TestWorker_t;
+
+static uint8 Test_streams[TEST_WORKERS + 1][TEST_STREAM_LENGTH];
+static TestWorker_t Test_workers[TEST_WORKERS];
+static SemaphoreHandle_t Test_done;
+static SemaphoreHandle_t Test_held;
+
+static uint8 Test_streamByte(uint8 sock, uint32 offset) {
+    return (uint8) (sock * 50 + offset % 50);
+}
+
+static void Test_fillStreams(void) {
+    for (uint8 sock = 0; sock <= TEST_WORKERS; sock++) {
+        for (uint32 i = 0; i < TEST_STREAM_LENGTH; i++) {
+            Test_streams[sock][i] = Test_streamByte(sock, i);
+        }
+        FakeNina_setRx(sock, ESTABLISHED, Test_streams[sock], TEST_STREAM_LENGTH);
+    }
+}
+
+static int Test_available(uint8 sock) {
+    uint16 avail = 0;
+    tParam inParams[] = {{1, &sock}};
+    tParam outParams[] = {{2, &avail}};
+    uint8 paramsRead;
+
+    SpiDrv_sendCmd(AVAIL_DATA_TCP_CMD, 1, inParams);
+    if (!SpiDrv_receiveResponseCmd(AVAIL_DATA_TCP_CMD, 20, &paramsRead, outParams, 1)) {
+        return -1;
+    }
+    return avail;
+}
+
+// Read the whole stream a chunk at a time, checking each chunk and the count left after it
+static void Test_worker(void *param) {
+    TestWorker_t *worker = param;
+    uint8 buffer[TEST_CHUNK];
+
+    while (worker->read < TEST_STREAM_LENGTH && worker->reads < TEST_MAX_READS) {
+        uint16 len = sizeof(buffer);
+        TickType_t start = xTaskGetTickCount();
+
+        memset(buffer, 0xAA, sizeof(buffer));
+        int got = ServerDrv_getDataBuf(worker->sock, buffer, &len);
+        worker->reads++;
+
+        if (got == 0) {
+            // Only a lock timeout may fail here, and it must leave everything alone
+            uint8 untouched = len == sizeof(buffer) &&
+                              FakeNina_socket(worker->sock)->rxPos == worker->read;
+            for (uint16 i = 0; i < sizeof(buffer); i++) {
+                untouched &= buffer[i] == 0xAA;
+            }
+            if (worker->timeouts++ == 0) {
+                worker->firstTimeoutTicks = xTaskGetTickCount() - start;
+                worker->untouched = untouched;
+            } else if (!untouched) {
+                worker->untouched = 0;
+            }
+            continue;
+        }
+
+        for (int i = 0; i < got; i++) {
+            if (buffer[i] != Test_streamByte(worker->sock, worker->read + i)) {
+                worker->errors++;
+            }
+        }
+        worker->read += got;
+
+        int avail = Test_available(worker->sock);
+        if (avail >= 0 && avail != (int) (TEST_STREAM_LENGTH - worker->read)) {
+            worker->errors++;
+        }
+    }
+
+    xSemaphoreGive(Test_done);
+    vTaskDelete(NULL);
+}
+
+static void Test_startWorkers(void) {
+    for (uint8 i = 0; i < TEST_WORKERS; i++) {
+        memset(&Test_workers[i], 0x00, sizeof(TestWorker_t));
+        Test_workers[i].sock = i;
+        xTaskCreate(Test_worker, "worker", 256, &Test_workers[i], 1, NULL);
+    }
+}
+
+static void Test_waitWorkers(void) {
+    for (int i = 0; i < TEST_WORKERS; i++) {
+        xSemaphoreTake(Test_done, portMAX_DELAY);
+    }
+}
+
+static void Test_noClashes(void) {
+    FakeNinaStats_t stats;
+
+    FakeNina_getStats(&stats);
+    CHECK_EQ(stats.clashes, 0);
+    CHECK_EQ(stats.badFrames, 0);
+    CHECK_EQ(stats.unknownCmds, 0);
+    CHECK_EQ(stats.unselectedBytes, 0);
+}
+
+// Everyone at once, with a task switch after every transfer
+static void Test_hammer(void) {
+    Test_fillStreams();
+    FakeNina_setPreempt(1);
+    Test_startWorkers();
+    Test_waitWorkers();
+    FakeNina_setPreempt(0);
+
+    for (int i = 0; i < TEST_WORKERS; i++) {
+        CHECK_EQ(Test_workers[i].read, TEST_STREAM_LENGTH);
+        CHECK_EQ(Test_workers[i].reads, TEST_STREAM_LENGTH / TEST_CHUNK);
+        CHECK_EQ(Test_workers[i].errors, 0);
+        CHECK_EQ(Test_workers[i].timeouts, 0);
+    }
+    Test_noClashes();
+}
+
+static int Test_hogResult;
+
+// Takes the bus, has a command answered only after everyone else's lock timeout has run out
+static void Test_hog(void *param) {
+    uint8 sock = TEST_WORKERS;
+    uint16 avail = 0;
+    tParam inParams[] = {{1, &sock}};
+    tParam outParams[] = {{2, &avail}};
+    uint8 paramsRead;
+
+    SpiDrv_lockBus(portMAX_DELAY);
+    SpiDrv_sendCmd(AVAIL_DATA_TCP_CMD, 1, inParams);
+    xSemaphoreGive(Test_held);
+
+    vTaskDelay(pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS) + 1000);
+
+    Test_hogResult = SpiDrv_receiveResponseCmd(AVAIL_DATA_TCP_CMD, 20, &paramsRead, outParams, 1) ? avail : -1;
+    SpiDrv_unlockBus();
+
+    xSemaphoreGive(Test_done);
+    vTaskDelete(NULL);
+}
+
+// Workers that can't get the bus in time fail their command cleanly and get it once it's free
+static void Test_lockTimeout(void) {
+    Test_fillStreams();
+    FakeNina_setPreempt(1);
+
+    xTaskCreate(Test_hog, "hog", 256, NULL, 1, NULL);
+    xSemaphoreTake(Test_held, portMAX_DELAY);
+
+    Test_startWorkers();
+    Test_waitWorkers();
+    xSemaphoreTake(Test_done, portMAX_DELAY);
+    FakeNina_setPreempt(0);
+
+    CHECK_EQ(Test_hogResult, TEST_STREAM_LENGTH);
+    for (int i = 0; i < TEST_WORKERS; i++) {
+        CHECK(Test_workers[i].timeouts > 0);
+        CHECK_EQ(Test_workers[i].firstTimeoutTicks, pdMS_TO_TICKS(WIFI_SPI_BUS_TIMEOUT_MS));
+        CHECK(Test_workers[i].untouched);
+        CHECK_EQ(Test_workers[i].read, TEST_STREAM_LENGTH);
+        CHECK_EQ(Test_workers[i].errors, 0);
+    }
+    Test_noClashes();
+
+    // Nobody is left holding the bus
+    CHECK_EQ(Test_available(TEST_WORKERS), TEST_STREAM_LENGTH);
+    CHECK(!SpiDrv_ownsBus());
+}
+
+int main(void) {
+    Test_done = xSemaphoreCreateCounting(TEST_WORKERS + 1, 0);
+    Test_held = xSemaphoreCreateBinary();
+
+    RUN(Test_hammer);
+    RUN(Test_lockTimeout);
+    return Test_report("test_bus_lock");
+}
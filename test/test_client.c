@@ -0,0 +1,122 @@
+/*
+  test_client.c - WiFiClient write window tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "WiFiClient.h"
+#include "spi_drv.h"
+#include "server_drv.h"
+#include "wifi_spi.h"
+
+static const uint8 Test_data[16];
+
+static uint8 Test_byte = 'x';
+
+static FakeNinaSocket_t *Test_connect(uint8 sock) {
+    FakeNina_setRx(sock, ESTABLISHED, Test_data, 0);
+    return FakeNina_socket(sock);
+}
+
+// DATA_SENT is only asked once per window's worth of sends, and flush asks for whatever is left
+static void Test_window(void) {
+    FakeNinaSocket_t *socket = Test_connect(1);
+
+    WiFiClient_setWriteWindow(1, 3);
+    for (int i = 0; i < 7; i++) {
+        CHECK_EQ(WiFiClient_write(1, &Test_byte, 1), 1);
+    }
+    CHECK_EQ(socket->txLength, 7);
+    CHECK_EQ(socket->dataSent, 2);
+
+    CHECK_EQ(WiFiClient_flush(1), 1);
+    CHECK_EQ(socket->dataSent, 3);
+
+    // Nothing in flight, nothing to ask
+    CHECK_EQ(WiFiClient_flush(1), 1);
+    CHECK_EQ(socket->dataSent, 3);
+
+    // Shrinking below what's in flight flushes first
+    WiFiClient_write(1, &Test_byte, 1);
+    WiFiClient_write(1, &Test_byte, 1);
+    WiFiClient_setWriteWindow(1, 1);
+    CHECK_EQ(socket->dataSent, 4);
+}
+
+// DATA_SENT never coming back is reported, not swallowed
+static void Test_flushFails(void) {
+    FakeNinaSocket_t *socket = Test_connect(2);
+
+    WiFiClient_setWriteWindow(2, 4);
+    WiFiClient_write(2, &Test_byte, 1);
+    WiFiClient_write(2, &Test_byte, 1);
+
+    FakeNina_failCmd(DATA_SENT_TCP_CMD, 2, 10000);
+    TickType_t start = xTaskGetTickCount();
+    CHECK_EQ(WiFiClient_flush(2), 0);
+    CHECK(xTaskGetTickCount() - start >= pdMS_TO_TICKS(DATA_SENT_TIMEOUT_MS));
+    FakeNina_failCmd(DATA_SENT_TCP_CMD, 2, 0);
+
+    // That was the barrier, so there's nothing left to wait for
+    CHECK_EQ(WiFiClient_flush(2), 1);
+    CHECK_EQ(socket->dataSent, 0);
+    WiFiClient_setWriteWindow(2, 0);
+}
+
+// A write whose window check fails reports only what was acknowledged before it
+static void Test_writeUnacked(void) {
+    static uint8 data[2 * WIFI_SOCKET_BUFFER_SIZE];
+
+    Test_connect(3);
+    WiFiClient_setWriteWindow(3, 1);
+    CHECK_EQ(WiFiClient_write(3, data, WIFI_SOCKET_BUFFER_SIZE), WIFI_SOCKET_BUFFER_SIZE);
+
+    FakeNina_failCmd(DATA_SENT_TCP_CMD, 3, 10000);
+    CHECK_EQ(WiFiClient_write(3, data, sizeof(data)), 0);
+    FakeNina_failCmd(DATA_SENT_TCP_CMD, 3, 0);
+    WiFiClient_setWriteWindow(3, 0);
+}
+
+// The next connection on a socket doesn't inherit the last one's window
+static void Test_stopResetsWindow(void) {
+    FakeNinaSocket_t *socket = Test_connect(4);
+
+    WiFiClient_setWriteWindow(4, 8);
+    WiFiClient_write(4, &Test_byte, 1);
+    WiFiClient_write(4, &Test_byte, 1);
+    CHECK_EQ(socket->dataSent, 0);
+
+    WiFiClient_stop(4);
+    CHECK_EQ(socket->dataSent, 1);
+    CHECK_EQ(socket->state, CLOSED);
+
+    socket = Test_connect(4);
+    socket->dataSent = 0;
+    for (int i = 0; i < WIFI_CLIENT_WRITE_WINDOW; i++) {
+        WiFiClient_write(4, &Test_byte, 1);
+    }
+    CHECK_EQ(socket->dataSent, 1);
+    CHECK_EQ(WiFiClient_flush(4), 1);
+}
+
+int main(void) {
+    RUN(Test_window);
+    RUN(Test_flushFails);
+    RUN(Test_writeUnacked);
+    RUN(Test_stopResetsWindow);
+    return Test_report("test_client");
+}
@@ -0,0 +1,130 @@
+/*
+  test_server.c - WiFiServer accept queue tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "WiFiServer.h"
+#include "server_drv.h"
+#include "wifi_spi.h"
+
+static const uint8 Test_data[16];
+
+// A server on a socket other than 0, so a stray 0 from the co-processor would look like a client
+static uint8 Test_begin(void) {
+    FakeNina_setRx(0, ESTABLISHED, Test_data, 0);
+
+    int server = WiFiServer_begin(80);
+    CHECK_EQ(server, 1);
+    return server;
+}
+
+// A client connects and sends something, which is when the co-processor reports it
+static void Test_connect(uint8 server, uint8 client) {
+    FakeNina_setRx(client, ESTABLISHED, Test_data, sizeof(Test_data));
+    FakeNina_lock();
+    FakeNina_socket(server)->client = client;
+    FakeNina_unlock();
+}
+
+static void Test_accept(void) {
+    uint8 server = Test_begin();
+
+    CHECK_EQ(WiFiServer_poll(server), 0);
+    CHECK_EQ(WiFiServer_accept(server, 0), NO_SOCKET_AVAIL);
+
+    Test_connect(server, 3);
+    CHECK_EQ(WiFiServer_accept(server, 0), 3);
+    CHECK_EQ(WiFiServer_clients(server), WIFI_SOCKET_BIT(3));
+
+    // Still reported while its data is unread, but it has been handed out already
+    CHECK_EQ(WiFiServer_poll(server), 0);
+    CHECK_EQ(WiFiServer_accept(server, 0), NO_SOCKET_AVAIL);
+}
+
+// A query that fails is no client at all
+static void Test_failedPoll(void) {
+    uint8 server = Test_begin();
+
+    FakeNina_failCmd(AVAIL_DATA_TCP_CMD, server, 1);
+    CHECK_EQ(ServerDrv_availData(server), -1);
+
+    FakeNina_failCmd(AVAIL_DATA_TCP_CMD, server, 1);
+    CHECK_EQ(WiFiServer_poll(server), 0);
+    CHECK_EQ(WiFiServer_clients(server), 0);
+
+    FakeNina_failCmd(AVAIL_DATA_TCP_CMD, server, 3);
+    CHECK_EQ(WiFiServer_accept(server, 10), NO_SOCKET_AVAIL);
+    CHECK_EQ(WiFiServer_clients(server), 0);
+
+    // The next good answer still gets through
+    Test_connect(server, 2);
+    CHECK_EQ(WiFiServer_accept(server, 0), 2);
+}
+
+// Clients come out in the order they were seen, and the ones that don't fit wait their turn
+static void Test_queueFull(void) {
+    uint8 server = Test_begin();
+
+    for (uint8 i = 0; i <= WIFI_SERVER_ACCEPT_QUEUE; i++) {
+        Test_connect(server, 2 + i);
+        CHECK_EQ(WiFiServer_poll(server), (i < WIFI_SERVER_ACCEPT_QUEUE) ? i + 1 : WIFI_SERVER_ACCEPT_QUEUE);
+    }
+    CHECK(!(WiFiServer_clients(server) & WIFI_SOCKET_BIT(2 + WIFI_SERVER_ACCEPT_QUEUE)));
+
+    CHECK_EQ(WiFiServer_accept(server, 0), 2);
+    for (uint8 i = 1; i <= WIFI_SERVER_ACCEPT_QUEUE; i++) {
+        CHECK_EQ(WiFiServer_accept(server, 0), 2 + i);
+    }
+    CHECK_EQ(WiFiServer_clients(server) & WIFI_SOCKET_BIT(2 + WIFI_SERVER_ACCEPT_QUEUE),
+             WIFI_SOCKET_BIT(2 + WIFI_SERVER_ACCEPT_QUEUE));
+}
+
+// A client that is gone before it was accepted is dropped from the queue
+static void Test_closedBeforeAccept(void) {
+    uint8 server = Test_begin();
+
+    Test_connect(server, 2);
+    CHECK_EQ(WiFiServer_poll(server), 1);
+    Test_connect(server, 4);
+    CHECK_EQ(WiFiServer_poll(server), 2);
+
+    FakeNina_setRx(2, CLOSED, Test_data, 0);
+    FakeRtos_advance(pdMS_TO_TICKS(WIFI_SOCKET_STATE_MAX_AGE_MS) + 1);
+    CHECK_EQ(WiFiServer_poll(server), 1);
+    CHECK_EQ(WiFiServer_accept(server, 0), 4);
+    CHECK_EQ(WiFiServer_clients(server), WIFI_SOCKET_BIT(4));
+}
+
+// Nothing turns up: back off until the timeout and give up
+static void Test_acceptTimeout(void) {
+    uint8 server = Test_begin();
+    TickType_t start = xTaskGetTickCount();
+
+    CHECK_EQ(WiFiServer_accept(server, 250), NO_SOCKET_AVAIL);
+    CHECK_EQ(xTaskGetTickCount() - start, 250);
+    CHECK_EQ(WiFiServer_accept(server + 1, 0), NO_SOCKET_AVAIL);
+}
+
+int main(void) {
+    RUN(Test_accept);
+    RUN(Test_failedPoll);
+    RUN(Test_queueFull);
+    RUN(Test_closedBeforeAccept);
+    RUN(Test_acceptTimeout);
+    return Test_report("test_server");
+}
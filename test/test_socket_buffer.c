@@ -0,0 +1,261 @@
+/*
+  test_socket_buffer.c - Receive ring tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "WiFiClient.h"
+#include "WiFiSocketBuffer.h"
+#include "WiFiTask.h"
+#include "semphr.h"
+#include "spi_drv.h"
+#include "wifi_spi.h"
+
+#include <string.h>
+
+static uint8 Test_data[4096];
+
+static void Test_setRx(uint8 sock, uint32 length) {
+    for (uint32 i = 0; i < sizeof(Test_data); i++) {
+        Test_data[i] = i * 13 + (i >> 8);
+    }
+    FakeNina_setRx(sock, ESTABLISHED, Test_data, length);
+    WiFiSocketBuffer_init();
+}
+
+static int Test_poolInUse(void) {
+    WiFiSocketBufferPoolStats_t stats;
+
+    WiFiSocketBuffer_getPoolStats(&stats);
+    return stats.inUse;
+}
+
+static void Test_read(void) {
+    uint8 data[100];
+
+    Test_setRx(0, 250);
+    CHECK_EQ(WiFiSocketBuffer_available(0), 250);
+    CHECK_EQ(WiFiSocketBuffer_peek(0), Test_data[0]);
+
+    for (int pos = 0; pos < 250; pos += sizeof(data)) {
+        int want = (250 - pos > (int) sizeof(data)) ? (int) sizeof(data) : 250 - pos;
+        CHECK_EQ(WiFiSocketBuffer_read(0, data, sizeof(data)), want);
+        CHECK(memcmp(data, &Test_data[pos], want) == 0);
+    }
+
+    // Drained, so the buffer went back to the pool
+    CHECK_EQ(WiFiSocketBuffer_read(0, data, sizeof(data)), 0);
+    CHECK_EQ(Test_poolInUse(), 0);
+}
+
+// Small ring so the staged data wraps around its end
+static void Test_wraparound(void) {
+    uint8 data[64];
+    uint32 pos = 0;
+
+    Test_setRx(2, 1000);
+    CHECK(WiFiSocketBuffer_setDepth(2, 100, 60));
+
+    while (pos < 1000) {
+        uint32 want = (1000 - pos > 37) ? 37 : 1000 - pos;
+        int len = WiFiSocketBuffer_read(2, data, want);
+
+        // Whatever is staged, up to want
+        CHECK(len > 0 && len <= (int) want);
+        if (len <= 0 || memcmp(data, &Test_data[pos], len) != 0) {
+            CHECK(!"data out of order");
+            break;
+        }
+        pos += len;
+
+        // Top the ring up behind the reader, so the next fetch lands after the wrap
+        WiFiSocketBuffer_prefetch(2);
+        CHECK(WiFiSocketBuffer_buffered(2) <= 100);
+    }
+
+    CHECK_EQ(FakeNina_socket(2)->rxPos, 1000);
+    CHECK_EQ(WiFiSocketBuffer_available(2), 0);
+    CHECK_EQ(Test_poolInUse(), 0);
+}
+
+// Large reads skip the ring, but only once what was staged has gone first
+static void Test_readInto(void) {
+    static uint8 data[2048];
+
+    Test_setRx(3, 2000);
+    CHECK_EQ(WiFiSocketBuffer_setDepth(3, 100, 0), 1);
+    CHECK_EQ(WiFiSocketBuffer_read(3, data, 10), 10);
+    CHECK_EQ(WiFiSocketBuffer_buffered(3), 90);
+
+    // The staged 90, then one direct fetch of as much as a transfer moves
+    int len = WiFiSocketBuffer_readInto(3, data + 10, sizeof(data) - 10);
+    CHECK_EQ(len, 90 + WIFI_SOCKET_BUFFER_SIZE);
+
+    len = WiFiSocketBuffer_readInto(3, data + 10 + len, sizeof(data) - 10 - len);
+    CHECK_EQ(len, 2000 - 100 - WIFI_SOCKET_BUFFER_SIZE);
+    CHECK(memcmp(data, Test_data, 2000) == 0);
+    CHECK_EQ(WiFiSocketBuffer_buffered(3), 0);
+    CHECK_EQ(Test_poolInUse(), 0);
+}
+
+static void Test_readLine(void) {
+    static const char text[] = "HTTP/1.1 200 OK\r\nServer: fake\n\r\npartial";
+    char line[64];
+
+    FakeNina_setRx(4, ESTABLISHED, (const uint8 *) text, strlen(text));
+    WiFiSocketBuffer_init();
+
+    CHECK_EQ(WiFiSocketBuffer_readLine(4, line, sizeof(line), 10), 15);
+    CHECK(strcmp(line, "HTTP/1.1 200 OK") == 0);
+    CHECK_EQ(WiFiSocketBuffer_readLine(4, line, sizeof(line), 10), 12);
+    CHECK(strcmp(line, "Server: fake") == 0);
+    CHECK_EQ(WiFiSocketBuffer_readLine(4, line, sizeof(line), 10), 0);
+
+    // No end of line before the timeout
+    TickType_t start = xTaskGetTickCount();
+    CHECK_EQ(WiFiSocketBuffer_readLine(4, line, sizeof(line), 50), -1);
+    CHECK(strcmp(line, "partial") == 0);
+    CHECK(xTaskGetTickCount() - start >= 50);
+}
+
+static void Test_readLineFull(void) {
+    static const char text[] = "0123456789\n";
+    char line[6];
+
+    FakeNina_setRx(4, ESTABLISHED, (const uint8 *) text, strlen(text));
+    WiFiSocketBuffer_init();
+
+    CHECK_EQ(WiFiSocketBuffer_readLine(4, line, sizeof(line), 10), -1);
+    CHECK(strcmp(line, "01234") == 0);
+}
+
+static void Test_readUntil(void) {
+    uint8 data[32];
+
+    Test_setRx(5, 300);
+    Test_data[40] = 0xA5;
+    for (int i = 0; i < 40; i++) {
+        if (Test_data[i] == 0xA5) {
+            Test_data[i] = 0;
+        }
+    }
+
+    CHECK_EQ(WiFiSocketBuffer_readUntil(5, 0xA5, data, sizeof(data), 10), 32);
+    CHECK_EQ(WiFiSocketBuffer_readUntil(5, 0xA5, data, sizeof(data), 10), 9);
+    CHECK_EQ(data[8], 0xA5);
+}
+
+static void Test_readExact(void) {
+    static uint8 data[3000];
+
+    Test_setRx(6, 2500);
+    CHECK_EQ(WiFiSocketBuffer_readExact(6, data, 2500, 100), 2500);
+    CHECK(memcmp(data, Test_data, 2500) == 0);
+
+    // Only what there is, once the timeout passes
+    FakeNina_setRx(6, ESTABLISHED, Test_data, 100);
+    CHECK_EQ(WiFiSocketBuffer_readExact(6, data, 200, 20), 100);
+}
+
+static void Test_close(void) {
+    uint8 data[16];
+
+    Test_setRx(7, 500);
+    CHECK_EQ(WiFiSocketBuffer_read(7, data, sizeof(data)), sizeof(data));
+    CHECK_EQ(Test_poolInUse(), 1);
+
+    WiFiSocketBuffer_close(7);
+    CHECK_EQ(WiFiSocketBuffer_buffered(7), 0);
+    CHECK_EQ(Test_poolInUse(), 0);
+}
+
+// More sockets with data than pool buffers: the rest wait, nothing is lost
+static void Test_poolExhausted(void) {
+    uint8 data[8];
+
+    WiFiSocketBuffer_init();
+    for (uint8 sock = 0; sock <= WIFI_SOCKET_BUFFER_POOL_SIZE; sock++) {
+        FakeNina_setRx(sock, ESTABLISHED, Test_data, 100);
+        CHECK_EQ(WiFiSocketBuffer_read(sock, data, 1), sock < WIFI_SOCKET_BUFFER_POOL_SIZE);
+    }
+    CHECK_EQ(FakeNina_socket(WIFI_SOCKET_BUFFER_POOL_SIZE)->rxPos, 0);
+
+    WiFiSocketBuffer_close(0);
+    CHECK_EQ(WiFiSocketBuffer_read(WIFI_SOCKET_BUFFER_POOL_SIZE, data, 1), 1);
+    CHECK_EQ(data[0], Test_data[0]);
+    WiFiSocketBuffer_deinit();
+    CHECK_EQ(Test_poolInUse(), 0);
+}
+
+static SemaphoreHandle_t Test_gate;
+
+// Keeps the I/O task busy until the test opens the gate.  Lets the bus go meanwhile so the test can use it.
+static int Test_gateHandler(void *arg) {
+    SpiDrv_unlockBus();
+    xSemaphoreTake(Test_gate, portMAX_DELAY);
+    SpiDrv_lockBus(portMAX_DELAY);
+    return 0;
+}
+
+// The far end closes while a prefetch is carrying the last of its data: none of it is lost
+static void Test_prefetchInFlight(void) {
+    static WiFiTaskOp_t gateOp = {Test_gateHandler, NULL, 0, NULL, NULL, NULL, 0};
+    uint8 data[128];
+
+    Test_gate = xSemaphoreCreateBinary();
+    Test_setRx(2, 200);
+    WiFiSocketBuffer_setDepth(2, sizeof(data), sizeof(data) / 2);
+    CHECK(WiFiTask_start(1, 256));
+    CHECK(WiFiTask_submit(&gateOp, 0));
+
+    // The first chunk is fetched here, draining it queues the rest on the I/O task behind the gate
+    CHECK_EQ(WiFiSocketBuffer_read(2, data, sizeof(data)), sizeof(data));
+    CHECK(WiFiSocketBuffer_fetching(2));
+    CHECK_EQ(WiFiSocketBuffer_buffered(2), 0);
+
+    // The I/O task is stuck, so available() gives up waiting, but the socket stays open
+    FakeNina_socket(2)->state = CLOSE_WAIT;
+    TickType_t start = xTaskGetTickCount();
+    CHECK_EQ(WiFiClient_available(2), 0);
+    CHECK_EQ(xTaskGetTickCount() - start, pdMS_TO_TICKS(WIFI_SOCKET_BUFFER_FETCH_WAIT_MS));
+    CHECK(WiFiClient_connected(2));
+
+    // Once it's let go the tail is there to read, and only then does the socket close
+    xSemaphoreGive(Test_gate);
+    CHECK(WiFiClient_connected(2));
+    CHECK_EQ(WiFiClient_available(2), 72);
+    CHECK_EQ(WiFiClient_read(2, data, sizeof(data)), 72);
+    CHECK(memcmp(data, &Test_data[sizeof(data)], 72) == 0);
+    CHECK(!WiFiClient_connected(2));
+    CHECK(!WiFiSocketBuffer_fetching(2));
+    CHECK_EQ(Test_poolInUse(), 0);
+}
+
+int main(void) {
+    RUN(Test_read);
+    RUN(Test_wraparound);
+    RUN(Test_readInto);
+    RUN(Test_readLine);
+    RUN(Test_readLineFull);
+    RUN(Test_readUntil);
+    RUN(Test_readExact);
+    RUN(Test_close);
+    RUN(Test_poolExhausted);
+    // Leaves the I/O task running, so it goes last
+    RUN(Test_prefetchInFlight);
+    return Test_report("test_socket_buffer");
+}
@@ -0,0 +1,111 @@
+/*
+  test_socket_table.c - Socket state table tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "WiFiSocket.h"
+#include "WiFiSocketBuffer.h"
+#include "wifi_spi.h"
+
+static const uint8 Test_data[64];
+
+static void Test_refresh(void) {
+    FakeNina_setRx(1, ESTABLISHED, Test_data, 10);
+    FakeNina_setRx(3, CLOSE_WAIT, Test_data, 0);
+
+    WiFiSocketSet_t set = WIFI_SOCKET_BIT(1) | WIFI_SOCKET_BIT(3);
+    CHECK_EQ(WiFiSocket_refresh(set), set);
+
+    const WiFiSocketState_t *state = WiFiSocket_state(1);
+    CHECK(state != NULL);
+    CHECK_EQ(state->tcpState, ESTABLISHED);
+    CHECK_EQ(state->available, 10);
+    CHECK_EQ(WiFiSocket_events(1, 0xFF), WIFI_SOCKET_READABLE | WIFI_SOCKET_WRITABLE | WIFI_SOCKET_CONNECTED);
+    CHECK_EQ(WiFiSocket_events(3, 0xFF), WIFI_SOCKET_WRITABLE);
+
+    // Served from the table while it's fresh
+    FakeNinaStats_t stats;
+    FakeNina_resetStats();
+    WiFiSocket_events(1, WIFI_SOCKET_READABLE);
+    FakeNina_getStats(&stats);
+    CHECK_EQ(stats.frames, 0);
+
+    FakeRtos_advance(pdMS_TO_TICKS(WIFI_SOCKET_STATE_MAX_AGE_MS) + 1);
+    CHECK(WiFiSocket_state(1) == NULL);
+    FakeNina_socket(1)->state = CLOSED;
+    CHECK_EQ(WiFiSocket_events(1, WIFI_SOCKET_CLOSED), WIFI_SOCKET_CLOSED);
+}
+
+// A socket whose query failed keeps what the table knew, the others are still updated
+static void Test_failedQuery(void) {
+    FakeNina_setRx(1, ESTABLISHED, Test_data, 10);
+    FakeNina_setRx(2, ESTABLISHED, Test_data, 20);
+    WiFiSocket_refresh(WIFI_SOCKET_BIT(1) | WIFI_SOCKET_BIT(2));
+
+    FakeNina_socket(1)->rxLength = 30;
+    FakeNina_socket(2)->rxLength = 40;
+    FakeNina_failCmd(AVAIL_DATA_TCP_CMD, 2, 1);
+    CHECK_EQ(WiFiSocket_refresh(WIFI_SOCKET_BIT(1) | WIFI_SOCKET_BIT(2)), WIFI_SOCKET_BIT(1));
+    CHECK_EQ(WiFiSocket_state(1)->available, 30);
+    CHECK_EQ(WiFiSocket_state(2)->available, 20);
+    CHECK_EQ(WiFiSocket_state(2)->tcpState, ESTABLISHED);
+}
+
+// Never answered about means no events, not closed
+static void Test_neverAnswered(void) {
+    FakeNina_setRx(4, ESTABLISHED, Test_data, 0);
+    WiFiSocket_invalidate(4);
+    FakeNina_failCmd(GET_CLIENT_STATE_TCP_CMD, 4, 1);
+    CHECK_EQ(WiFiSocket_events(4, 0xFF), 0);
+    CHECK(WiFiSocket_state(4) == NULL);
+
+    CHECK_EQ(WiFiSocket_events(4, 0xFF), WIFI_SOCKET_WRITABLE | WIFI_SOCKET_CONNECTED);
+}
+
+// Data staged in the receive ring is readable even once the co-processor has none left
+static void Test_bufferedReadable(void) {
+    uint8 data[4];
+
+    WiFiSocketBuffer_init();
+    FakeNina_setRx(5, ESTABLISHED, Test_data, 10);
+    CHECK_EQ(WiFiSocketBuffer_read(5, data, sizeof(data)), sizeof(data));
+    WiFiSocket_invalidate(5);
+    CHECK_EQ(WiFiSocket_events(5, WIFI_SOCKET_READABLE), WIFI_SOCKET_READABLE);
+    WiFiSocketBuffer_deinit();
+}
+
+static void Test_wait(void) {
+    FakeNina_setRx(6, ESTABLISHED, Test_data, 0);
+    FakeNina_setRx(7, ESTABLISHED, Test_data, 0);
+
+    TickType_t start = xTaskGetTickCount();
+    CHECK_EQ(WiFiSocket_wait(WIFI_SOCKET_BIT(6) | WIFI_SOCKET_BIT(7), WIFI_SOCKET_READABLE, 100), 0);
+    CHECK_EQ(xTaskGetTickCount() - start, 100);
+
+    FakeNina_socket(7)->rxLength = 5;
+    CHECK_EQ(WiFiSocket_wait(WIFI_SOCKET_BIT(6) | WIFI_SOCKET_BIT(7), WIFI_SOCKET_READABLE, 100), WIFI_SOCKET_BIT(7));
+}
+
+int main(void) {
+    RUN(Test_refresh);
+    RUN(Test_failedQuery);
+    RUN(Test_neverAnswered);
+    RUN(Test_bufferedReadable);
+    RUN(Test_wait);
+    return Test_report("test_socket_table");
+}
@@ -0,0 +1,165 @@
+/*
+  test_spi_dma.c - DMA transport tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "spi_drv.h"
+#include "spi_dma.h"
+#include "server_drv.h"
+#include "wifi_drv.h"
+#include "WiFiSocketBuffer.h"
+
+#include <string.h>
+
+// Lands in the host's read-only data, which the fake DMA places in flash
+static const uint8 Test_flash[3 * SPI_DMA_CHUNK_SIZE + 5] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10,
+    0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20,
+    0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30,
+    0x31, 0x32, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0x40,
+    0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50,
+    0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x5B, 0x5C, 0x5D, 0x5E, 0x5F, 0x60,
+    0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x6B, 0x6C, 0x6D, 0x6E, 0x6F, 0x70,
+    0x71, 0x72, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x7B, 0x7C, 0x7D, 0x7E, 0x7F, 0x80,
+    0x81, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89, 0x8A, 0x8B, 0x8C, 0x8D, 0x8E, 0x8F, 0x90,
+    0x91, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0x9B, 0x9C, 0x9D, 0x9E, 0x9F, 0xA0,
+    0xA1, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF, 0xB0,
+    0xB1, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF, 0xC0,
+    0xC1, 0xC2, 0xC3, 0xC4, 0xC5,
+};
+
+static uint8 Test_pattern[WIFI_SOCKET_BUFFER_SIZE];
+
+static void Test_noFaults(void) {
+    FakeDmaStats_t dma;
+    FakeNinaStats_t nina;
+
+    FakeDma_getStats(&dma);
+    FakeNina_getStats(&nina);
+    CHECK_EQ(dma.faults, 0);
+    CHECK_EQ(nina.badFrames, 0);
+    CHECK_EQ(nina.unselectedBytes, 0);
+}
+
+// Sent and received lengths either side of every chunk boundary up to a few chunks in
+static void Test_chunkBoundaries(void) {
+    static uint8 data[WIFI_SOCKET_BUFFER_SIZE];
+    const uint16 sizes[] = {1, 2, SPI_DMA_CHUNK_SIZE - 7, SPI_DMA_CHUNK_SIZE - 1, SPI_DMA_CHUNK_SIZE,
+                            SPI_DMA_CHUNK_SIZE + 1, 2 * SPI_DMA_CHUNK_SIZE - 1, 2 * SPI_DMA_CHUNK_SIZE,
+                            2 * SPI_DMA_CHUNK_SIZE + 1, 3 * SPI_DMA_CHUNK_SIZE, 255, 256, 257, 1000,
+                            WIFI_SOCKET_BUFFER_SIZE};
+    FakeNinaSocket_t *socket = FakeNina_socket(1);
+
+    for (unsigned int n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+        uint16 size = sizes[n];
+
+        FakeNina_setRx(1, ESTABLISHED, Test_pattern, size);
+        socket->txLength = 0;
+
+        CHECK_EQ(ServerDrv_sendData(1, Test_pattern, size), size);
+        CHECK_EQ(socket->txLength, size);
+        CHECK(memcmp(socket->txData, Test_pattern, size) == 0);
+        CHECK_EQ(FakeNina_lastFrame()->length % 4, 0);
+
+        // Comes back through both receive buffers in turn
+        uint16 len = sizeof(data);
+        memset(data, 0x00, sizeof(data));
+        CHECK_EQ(ServerDrv_getDataBuf(1, data, &len), size);
+        CHECK_EQ(len, size);
+        CHECK(memcmp(data, Test_pattern, size) == 0);
+    }
+
+    FakeDmaStats_t stats;
+    FakeDma_getStats(&stats);
+    CHECK(stats.chunks > 0);
+    CHECK_EQ(stats.largestChunk, SPI_DMA_CHUNK_SIZE);
+    Test_noFaults();
+}
+
+// Data in flash goes out through the bounce buffers, the Tx channel itself only reads SRAM
+static void Test_flashSource(void) {
+    FakeNinaSocket_t *socket = FakeNina_socket(1);
+
+    for (uint16 size = 1; size <= sizeof(Test_flash); size += (size < 8) ? 1 : 29) {
+        FakeNina_setRx(1, ESTABLISHED, Test_pattern, 0);
+        socket->txLength = 0;
+
+        CHECK_EQ(ServerDrv_sendData(1, (uint8 *) Test_flash, size), size);
+        CHECK_EQ(socket->txLength, size);
+        CHECK(memcmp(socket->txData, Test_flash, size) == 0);
+    }
+    Test_noFaults();
+}
+
+// What the transport reads from: the caller's buffer when it's in SRAM, the bounce buffers when it isn't
+static void Test_txSource(void) {
+    static uint8 sram[2 * SPI_DMA_CHUNK_SIZE];
+    FakeDmaStats_t stats;
+
+    SpiDma_transport.transfer(sram, NULL, sizeof(sram));
+    FakeDma_getStats(&stats);
+    CHECK_EQ(stats.chunks, 2);
+    CHECK(stats.lastTxSource == sram + SPI_DMA_CHUNK_SIZE);
+
+    SpiDma_transport.transfer(Test_flash, NULL, sizeof(Test_flash));
+    FakeDma_getStats(&stats);
+    CHECK_EQ(stats.chunks, 6);
+    CHECK(stats.lastTxSource != NULL);
+    CHECK(stats.lastTxSource < Test_flash || stats.lastTxSource >= Test_flash + sizeof(Test_flash));
+    CHECK_EQ(stats.faults, 0);
+}
+
+// A reply read a byte at a time still comes back right, each byte its own descriptor
+static void Test_stringReply(void) {
+    CHECK(strcmp((char *) WiFiDrv_getFwVersion(), "1.4.8") == 0);
+    CHECK(strcmp((char *) WiFiDrv_getCurrentSSID(), "fake-ssid") == 0);
+    Test_noFaults();
+}
+
+// Going back to the byte transport leaves the DMA alone
+static void Test_byteTransport(void) {
+    FakeDmaStats_t stats;
+    uint32 ip = 0;
+
+    SpiDrv_setTransport(NULL);
+    CHECK(WiFiDrv_getIpAddress(&ip));
+    CHECK_EQ(ip, 0x0A00A8C0);
+    FakeDma_getStats(&stats);
+    CHECK_EQ(stats.chunks, 0);
+
+    SpiDrv_setTransport(&SpiDma_transport);
+    CHECK(WiFiDrv_getIpAddress(&ip));
+    FakeDma_getStats(&stats);
+    CHECK(stats.chunks > 0);
+    Test_noFaults();
+}
+
+int main(void) {
+    for (uint16 i = 0; i < sizeof(Test_pattern); i++) {
+        Test_pattern[i] = i * 7 + (i >> 8);
+    }
+
+    SpiDrv_setTransport(&SpiDma_transport);
+
+    RUN(Test_chunkBoundaries);
+    RUN(Test_flashSource);
+    RUN(Test_txSource);
+    RUN(Test_stringReply);
+    RUN(Test_byteTransport);
+    return Test_report("test_spi_dma");
+}
@@ -0,0 +1,304 @@
+/*
+  test_spi_drv.c - Reply parser and chunked send tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "spi_drv.h"
+#include "server_drv.h"
+#include "wifi_drv.h"
+#include "wl_definitions.h"
+
+#include <string.h>
+
+// A one byte command that answers with one byte, as most of them do
+static int Test_command(uint8 cmd, uint8 *value) {
+    uint8 dummy = DUMMY_DATA;
+    tParam inParams[] = {{1, &dummy}};
+    tParam outParams[] = {{1, value}};
+    uint8 paramsRead;
+
+    SpiDrv_sendCmd(cmd, 1, inParams);
+    return SpiDrv_receiveResponseCmd(cmd, 16, &paramsRead, outParams, 1);
+}
+
+static void Test_framesArePadded(void) {
+    uint8 name[40];
+
+    for (uint8 len = 0; len < sizeof(name); len++) {
+        memset(name, 'a', len);
+        WiFiDrv_setHostname(len ? name : (uint8 *) "");
+        CHECK_EQ(FakeNina_lastFrame()->cmd, SET_HOSTNAME_CMD);
+        CHECK_EQ(FakeNina_lastFrame()->length % 4, 0);
+    }
+
+    FakeNinaStats_t stats;
+    FakeNina_getStats(&stats);
+    CHECK_EQ(stats.badFrames, 0);
+    CHECK_EQ(stats.unknownCmds, 0);
+}
+
+static void Test_multiParamReply(void) {
+    uint32 ip = 0;
+    uint32 mask = 0;
+    uint32 gateway = 0;
+
+    CHECK(WiFiDrv_getIpAddress(&ip));
+    CHECK(WiFiDrv_getSubnetMask(&mask));
+    CHECK(WiFiDrv_getGatewayIP(&gateway));
+    CHECK_EQ(ip, 0x0A00A8C0);
+    CHECK_EQ(mask, 0x00FFFFFF);
+    CHECK_EQ(gateway, 0x0100A8C0);
+}
+
+static void Test_stringReply(void) {
+    CHECK(strcmp((char *) WiFiDrv_getFwVersion(), "1.4.8") == 0);
+    CHECK(strcmp((char *) WiFiDrv_getCurrentSSID(), "fake-ssid") == 0);
+}
+
+// The longest SSID there is still comes back NUL terminated
+static void Test_longSsid(void) {
+    uint8 reply[3 + 1 + WL_SSID_MAX_LENGTH + 1] = {START_CMD, GET_CURR_SSID_CMD | REPLY_FLAG, 1, WL_SSID_MAX_LENGTH};
+
+    memset(&reply[4], 'x', WL_SSID_MAX_LENGTH);
+    reply[sizeof(reply) - 1] = END_CMD;
+    FakeNina_replyRaw(reply, sizeof(reply));
+
+    uint8 *ssid = WiFiDrv_getCurrentSSID();
+    CHECK_EQ(strlen((char *) ssid), WL_SSID_MAX_LENGTH);
+}
+
+static void Test_longFwVersion(void) {
+    const uint8 reply[] = {START_CMD, GET_FW_VERSION_CMD | REPLY_FLAG, 1, WL_FW_VER_LENGTH,
+                           '1', '.', '1', '0', '.', '0', END_CMD};
+
+    // Whatever sits after a full length version must not run on into the string
+    WiFiDrv_getFwVersion()[WL_FW_VER_LENGTH] = 'x';
+
+    FakeNina_replyRaw(reply, sizeof(reply));
+    CHECK(strcmp((char *) WiFiDrv_getFwVersion(), "1.10.0") == 0);
+
+    // A shorter version doesn't keep the tail of the longer one
+    CHECK(strcmp((char *) WiFiDrv_getFwVersion(), "1.4.8") == 0);
+}
+
+static void Test_leadingGarbage(void) {
+    const uint8 reply[] = {0x00, 0xFF, START_CMD, GET_CONN_STATUS_CMD | REPLY_FLAG, 1, 1, WL_CONNECTED, END_CMD};
+    uint8 value = 0;
+
+    FakeNina_replyRaw(reply, sizeof(reply));
+    CHECK(Test_command(GET_CONN_STATUS_CMD, &value));
+    CHECK_EQ(value, WL_CONNECTED);
+}
+
+static void Test_errorReply(void) {
+    uint8 value = 0xAA;
+
+    FakeNina_failCmd(GET_CONN_STATUS_CMD, -1, 1);
+    CHECK(!Test_command(GET_CONN_STATUS_CMD, &value));
+    CHECK_EQ(WiFiDrv_getConnectionStatus(), WL_IDLE_STATUS);
+
+    // Nothing from the failed reply is left over to confuse the next one
+    FakeNina_setStatus(WL_CONNECTED);
+    CHECK_EQ(WiFiDrv_getConnectionStatus(), WL_CONNECTED);
+}
+
+static void Test_wrongCommand(void) {
+    const uint8 reply[] = {START_CMD, GET_FW_VERSION_CMD | REPLY_FLAG, 1, 1, 7, END_CMD};
+    uint8 value = 0;
+
+    FakeNina_replyRaw(reply, sizeof(reply));
+    CHECK(!Test_command(GET_CONN_STATUS_CMD, &value));
+    CHECK(Test_command(GET_CONN_STATUS_CMD, &value));
+}
+
+static void Test_noParams(void) {
+    const uint8 reply[] = {START_CMD, GET_CONN_STATUS_CMD | REPLY_FLAG, 0, END_CMD};
+    uint8 value = 0;
+
+    FakeNina_replyRaw(reply, sizeof(reply));
+    CHECK(!Test_command(GET_CONN_STATUS_CMD, &value));
+}
+
+static void Test_badEnd(void) {
+    const uint8 reply[] = {START_CMD, GET_CONN_STATUS_CMD | REPLY_FLAG, 1, 1, 7, 0x00};
+    uint8 value = 0;
+
+    FakeNina_replyRaw(reply, sizeof(reply));
+    CHECK(!Test_command(GET_CONN_STATUS_CMD, &value));
+}
+
+static void Test_tooLong(void) {
+    uint8 reply[3 + 1 + 20 + 1] = {START_CMD, GET_CONN_STATUS_CMD | REPLY_FLAG, 1, 20};
+    uint8 value = 0;
+
+    reply[sizeof(reply) - 1] = END_CMD;
+    FakeNina_replyRaw(reply, sizeof(reply));
+    CHECK(!Test_command(GET_CONN_STATUS_CMD, &value));
+
+    // And the bus was given back
+    CHECK(SpiDrv_lockBus(0));
+    SpiDrv_unlockBus();
+}
+
+/*
+ * Parameters too big for the caller's buffer are cut short but the rest of the frame is still
+ * read in step, small ones and ones read directly alike.
+ */
+static void Test_truncatedParams(void) {
+    uint8 reply[128];
+    uint16 len = 0;
+    uint8 a[4];
+    uint8 b[8];
+    uint8 c[4];
+    tParam outParams[] = {{sizeof(a), a}, {sizeof(b), b}, {sizeof(c), c}};
+    uint8 paramsRead;
+    uint8 dummy = DUMMY_DATA;
+    tParam inParams[] = {{1, &dummy}};
+
+    reply[len++] = START_CMD;
+    reply[len++] = GET_FW_VERSION_CMD | REPLY_FLAG;
+    reply[len++] = 3;
+    reply[len++] = 10;
+    for (uint8 i = 0; i < 10; i++) {
+        reply[len++] = 'A' + i;
+    }
+    reply[len++] = 40;
+    for (uint8 i = 0; i < 40; i++) {
+        reply[len++] = 'a' + i % 26;
+    }
+    reply[len++] = 2;
+    reply[len++] = '1';
+    reply[len++] = '2';
+    reply[len++] = END_CMD;
+    FakeNina_replyRaw(reply, len);
+
+    SpiDrv_sendCmd(GET_FW_VERSION_CMD, 1, inParams);
+    CHECK(SpiDrv_receiveResponseCmd(GET_FW_VERSION_CMD, 128, &paramsRead, outParams, 3));
+    CHECK_EQ(paramsRead, 3);
+    CHECK_EQ(outParams[0].paramLen, sizeof(a));
+    CHECK(memcmp(a, "ABCD", 4) == 0);
+    CHECK_EQ(outParams[1].paramLen, sizeof(b));
+    CHECK(memcmp(b, "abcdefgh", 8) == 0);
+    CHECK_EQ(outParams[2].paramLen, 2);
+    CHECK(memcmp(c, "12", 2) == 0);
+    CHECK_EQ(c[2], 0);
+}
+
+// Across the SPIM transfer size and the small parameter size, both ways
+static void Test_chunkedTransfers(void) {
+    static uint8 pattern[WIFI_SOCKET_BUFFER_SIZE];
+    static uint8 data[WIFI_SOCKET_BUFFER_SIZE];
+    const uint16 sizes[] = {1, 15, 16, 17, 200, 240, 248, 249, 250, 251, 252, 253, 254, 255, 256, 257, 258,
+                            509, 510, 511, 512, 1000, WIFI_SOCKET_BUFFER_SIZE};
+
+    for (uint16 i = 0; i < sizeof(pattern); i++) {
+        pattern[i] = i * 7 + (i >> 8);
+    }
+
+    for (unsigned int n = 0; n < sizeof(sizes) / sizeof(sizes[0]); n++) {
+        uint16 size = sizes[n];
+        FakeNinaSocket_t *socket = FakeNina_socket(1);
+
+        FakeNina_setRx(1, ESTABLISHED, pattern, size);
+        socket->txLength = 0;
+
+        CHECK_EQ(ServerDrv_sendData(1, pattern, size), size);
+        CHECK_EQ(socket->txLength, size);
+        CHECK(memcmp(socket->txData, pattern, size) == 0);
+        CHECK_EQ(FakeNina_lastFrame()->length % 4, 0);
+
+        socket->txLength = 0;
+        CHECK_EQ(ServerDrv_insertDataBuf(1, pattern, size), 1);
+        CHECK_EQ(socket->txLength, size);
+        CHECK_EQ(FakeNina_lastFrame()->length % 4, 0);
+
+        // Ask for more than there is to check the length comes back
+        uint16 len = sizeof(data);
+        memset(data, 0x00, sizeof(data));
+        CHECK_EQ(ServerDrv_getDataBuf(1, data, &len), size);
+        CHECK_EQ(len, size);
+        CHECK(memcmp(data, pattern, size) == 0);
+    }
+
+    FakeNinaStats_t stats;
+    FakeNina_getStats(&stats);
+    CHECK_EQ(stats.badFrames, 0);
+}
+
+static void Test_runCommands(void) {
+    uint8 dummy = DUMMY_DATA;
+    tParam inParams[] = {{1, &dummy}};
+    uint8 status = 0;
+    uint8 version[8];
+    uint8 enct = 0;
+    tParam outParams[] = {{1, &status}, {sizeof(version), version}, {1, &enct}};
+    SpiDrvCmd_t cmds[] = {
+        {GET_CONN_STATUS_CMD, 1, inParams, 16, 1, &outParams[0], 0, 0},
+        {GET_FW_VERSION_CMD, 1, inParams, 16, 1, &outParams[1], 0, 0},
+        {GET_CURR_ENCT_CMD, 1, inParams, 16, 1, &outParams[2], 0, 0},
+    };
+
+    FakeNina_setStatus(WL_CONNECTED);
+    FakeNina_failCmd(GET_FW_VERSION_CMD, -1, 1);
+    CHECK_EQ(SpiDrv_runCommands(cmds, 3), 2);
+    CHECK(cmds[0].result);
+    CHECK(!cmds[1].result);
+    CHECK(cmds[2].result);
+    CHECK_EQ(status, WL_CONNECTED);
+    CHECK_EQ(enct, ENC_TYPE_CCMP);
+
+    // The bus was given back however many times it was taken
+    CHECK(!SpiDrv_ownsBus());
+}
+
+static void Test_networks(void) {
+    WiFiDrvNetwork_t networks[WL_NETWORKS_LIST_MAXNUM];
+
+    FakeNina_setNetworks(7);
+    CHECK(WiFiDrv_startScanNetworks());
+    CHECK_EQ(WiFiDrv_getScanNetworks(), 7);
+    CHECK_EQ(WiFiDrv_getNetworks(networks, 7), 7);
+    CHECK(strcmp((char *) networks[6].ssid, "net6") == 0);
+    CHECK_EQ(networks[6].rssi, -46);
+    CHECK_EQ(networks[6].channel, 7);
+    CHECK_EQ(networks[6].bssid[WL_MAC_ADDR_LENGTH - 1], 6);
+
+    // One that fails is left out and the rest move up
+    FakeNina_failCmd(GET_IDX_RSSI_CMD, 2, 1);
+    CHECK_EQ(WiFiDrv_getNetworks(networks, 7), 6);
+    CHECK(strcmp((char *) networks[2].ssid, "net3") == 0);
+}
+
+int main(void) {
+    RUN(Test_framesArePadded);
+    RUN(Test_multiParamReply);
+    RUN(Test_stringReply);
+    RUN(Test_longSsid);
+    RUN(Test_longFwVersion);
+    RUN(Test_leadingGarbage);
+    RUN(Test_errorReply);
+    RUN(Test_wrongCommand);
+    RUN(Test_noParams);
+    RUN(Test_badEnd);
+    RUN(Test_tooLong);
+    RUN(Test_truncatedParams);
+    RUN(Test_chunkedTransfers);
+    RUN(Test_runCommands);
+    RUN(Test_networks);
+    return Test_report("test_spi_drv");
+}
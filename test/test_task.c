@@ -0,0 +1,200 @@
+/*
+  test_task.c - I/O task and async operation tests
+  Copyright (c) 2019 Gavin Hurlbut.  All rights reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "test.h"
+#include "WiFi.h"
+#include "WiFiClient.h"
+#include "WiFiDnsCache.h"
+#include "WiFiResolver.h"
+#include "WiFiTask.h"
+#include "semphr.h"
+#include "wifi_spi.h"
+
+#include <stdint.h>
+#include <string.h>
+
+static const uint8 Test_data[10] = "0123456789";
+static SemaphoreHandle_t Test_done;
+static SemaphoreHandle_t Test_entered;
+static SemaphoreHandle_t Test_gate;
+static volatile int Test_callbacks;
+
+static int Test_double(void *arg) {
+    return (int) (intptr_t) arg * 2;
+}
+
+// Slow on purpose: a waiter notified before it finished would see it hadn't run yet
+static void Test_slowCallback(WiFiTaskOp_t *op) {
+    vTaskDelay(10);
+    Test_callbacks++;
+}
+
+static void Test_doneCallback(WiFiTaskOp_t *op) {
+    Test_callbacks++;
+    xSemaphoreGive(Test_done);
+}
+
+static void Test_resolved(WiFiResolverRequest_t *request, void *arg) {
+    xSemaphoreGive(Test_done);
+}
+
+static int Test_gateHandler(void *arg) {
+    xSemaphoreGive(Test_entered);
+    xSemaphoreTake(Test_gate, portMAX_DELAY);
+    return 0;
+}
+
+// Without the I/O task an async operation completes before it returns
+static void Test_asyncInline(void) {
+    WiFiTaskOp_t op;
+    int context;
+
+    FakeNina_setStatus(WL_CONNECTED);
+    Test_callbacks = 0;
+    CHECK_EQ(WiFi_statusAsync(&op, xTaskGetCurrentTaskHandle(), Test_slowCallback, &context), 1);
+    CHECK_EQ(op.result, WL_CONNECTED);
+    CHECK(op.context == &context);
+    CHECK_EQ(Test_callbacks, 1);
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 1);
+}
+
+// The callback has run by the time the waiting task is notified
+static void Test_completionOrder(void) {
+    WiFiTaskOp_t op;
+
+    Test_callbacks = 0;
+    CHECK_EQ(WiFiTask_async(&op, Test_double, (void *) 21, xTaskGetCurrentTaskHandle(), Test_slowCallback, NULL), 1);
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, portMAX_DELAY), 1);
+    CHECK_EQ(Test_callbacks, 1);
+    CHECK_EQ(op.result, 42);
+}
+
+// WiFiTask_call waits on its own notification, not one the caller already had pending
+static void Test_callIndex(void) {
+    xTaskNotifyGive(xTaskGetCurrentTaskHandle());
+    CHECK_EQ(WiFiTask_call(Test_double, (void *) 5), 10);
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, 0), 1);
+    CHECK_EQ(ulTaskNotifyTakeIndexed(WIFI_TASK_NOTIFY_INDEX, pdTRUE, 0), 0);
+}
+
+static void Test_clientAsync(void) {
+    WiFiClientRequest_t request;
+    uint8 data[5] = {'h', 'e', 'l', 'l', 'o'};
+    int context;
+
+    FakeNina_setRx(1, ESTABLISHED, Test_data, sizeof(Test_data));
+
+    CHECK_EQ(WiFiClient_writeAsync(&request, 1, data, sizeof(data), xTaskGetCurrentTaskHandle(), NULL, NULL), 1);
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, portMAX_DELAY), 1);
+    CHECK_EQ(request.op.result, sizeof(data));
+    CHECK_EQ(FakeNina_socket(1)->txLength, sizeof(data));
+    CHECK(memcmp(FakeNina_socket(1)->txData, data, sizeof(data)) == 0);
+
+    Test_callbacks = 0;
+    CHECK_EQ(WiFiClient_availableAsync(&request, 1, NULL, Test_doneCallback, &context), 1);
+    xSemaphoreTake(Test_done, portMAX_DELAY);
+    CHECK_EQ(request.op.result, sizeof(Test_data));
+    CHECK(request.op.context == &context);
+    CHECK_EQ(Test_callbacks, 1);
+
+    FakeNina_setStatus(WL_DISCONNECTED);
+    FakeRtos_advance(pdMS_TO_TICKS(WIFI_LINK_REFRESH_MS) + 1);
+    CHECK_EQ(WiFi_statusAsync(&request.op, xTaskGetCurrentTaskHandle(), NULL, NULL), 1);
+    CHECK_EQ(ulTaskNotifyTake(pdTRUE, portMAX_DELAY), 1);
+    CHECK_EQ(request.op.result, WL_DISCONNECTED);
+}
+
+// Async submits never wait for room in the queue
+static void Test_queueFull(void) {
+    static WiFiTaskOp_t gate = {Test_gateHandler, NULL, 0, NULL, NULL, NULL, 0};
+    static WiFiTaskOp_t ops[WIFI_TASK_QUEUE_LENGTH + 1];
+    TickType_t start;
+
+    CHECK(WiFiTask_submit(&gate, 0));
+    xSemaphoreTake(Test_entered, portMAX_DELAY);
+
+    start = xTaskGetTickCount();
+    for (int i = 0; i < WIFI_TASK_QUEUE_LENGTH; i++) {
+        CHECK_EQ(WiFiTask_async(&ops[i], Test_double, (void *) (intptr_t) i, xTaskGetCurrentTaskHandle(), NULL, NULL),
+                 1);
+    }
+    CHECK_EQ(WiFiTask_async(&ops[WIFI_TASK_QUEUE_LENGTH], Test_double, NULL, xTaskGetCurrentTaskHandle(), NULL, NULL),
+             0);
+    CHECK_EQ(xTaskGetTickCount() - start, 0);
+
+    xSemaphoreGive(Test_gate);
+    for (int i = 0; i < WIFI_TASK_QUEUE_LENGTH; i++) {
+        CHECK_EQ(ulTaskNotifyTake(pdFALSE, portMAX_DELAY), WIFI_TASK_QUEUE_LENGTH - i);
+    }
+    for (int i = 0; i < WIFI_TASK_QUEUE_LENGTH; i++) {
+        CHECK_EQ(ops[i].result, 2 * i);
+    }
+}
+
+// A lookup started with the queue full returns at once and goes with the next one
+static void Test_resolverQueueFull(void) {
+    static WiFiTaskOp_t gate = {Test_gateHandler, NULL, 0, NULL, NULL, NULL, 0};
+    static WiFiTaskOp_t ops[WIFI_TASK_QUEUE_LENGTH];
+    WiFiResolverRequest_t first;
+    WiFiResolverRequest_t second;
+    TickType_t start;
+
+    WiFiDnsCache_flush();
+    CHECK(WiFiTask_submit(&gate, 0));
+    xSemaphoreTake(Test_entered, portMAX_DELAY);
+    for (int i = 0; i < WIFI_TASK_QUEUE_LENGTH; i++) {
+        CHECK_EQ(WiFiTask_async(&ops[i], Test_double, NULL, xTaskGetCurrentTaskHandle(), NULL, NULL), 1);
+    }
+
+    start = xTaskGetTickCount();
+    WiFiResolver_start(&first, (const uint8 *) "first.example.com", NULL, NULL);
+    CHECK_EQ(xTaskGetTickCount() - start, 0);
+    CHECK_EQ(first.state, WIFI_RESOLVE_QUEUED);
+    CHECK_EQ(WiFiResolver_pending(), 1);
+
+    xSemaphoreGive(Test_gate);
+    for (int i = 0; i < WIFI_TASK_QUEUE_LENGTH; i++) {
+        ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
+    }
+    CHECK_EQ(first.state, WIFI_RESOLVE_QUEUED);
+
+    WiFiResolver_start(&second, (const uint8 *) "second.example.com", Test_resolved, NULL);
+    xSemaphoreTake(Test_done, portMAX_DELAY);
+    CHECK_EQ(first.state, WIFI_RESOLVE_DONE);
+    CHECK_EQ(first.ip, 0x0100000A);
+    CHECK_EQ(second.state, WIFI_RESOLVE_DONE);
+    CHECK_EQ(WiFiResolver_pending(), 0);
+}
+
+int main(void) {
+    Test_done = xSemaphoreCreateBinary();
+    Test_entered = xSemaphoreCreateBinary();
+    Test_gate = xSemaphoreCreateBinary();
+
+    RUN(Test_asyncInline);
+
+    // Everything from here on has the I/O task running
+    CHECK(WiFiTask_start(1, 256));
+    RUN(Test_completionOrder);
+    RUN(Test_callIndex);
+    RUN(Test_clientAsync);
+    RUN(Test_queueFull);
+    RUN(Test_resolverQueueFull);
+    return Test_report("test_task");
+}